@@ -0,0 +1,48 @@
+/*********************************************************************************************/
+//
+//  FILE        : clock_config.h
+//  DATE        : 2025/11/25 Tue.
+//  DESCRIPTION : クロックの分周設定と各クロックの周波数
+//  CPU TYPE    : RX Family
+//
+//  Author T.Ijiro
+//
+//  init_CLK が書く PLLCR, SCKCR はここの分周設定から作る. 周辺機能のタイミング
+//  (CMT の1ms, 音階表, SCI のビットレート, LCD の待ち時間, FCU の周辺クロック通知)は
+//  CLK_PCLKB_HZ, CLK_FCLK_HZ から求めるので, クロックを変えるときはここだけ変える.
+//  分周設定は2のべき乗の指数 (0 = 1分周, 1 = 2分周, 2 = 4分周 ... 6 = 64分周).
+/************************************************************************************************/
+#ifndef CLOCK_CONFIG_H_
+#define CLOCK_CONFIG_H_
+
+/************************************ マクロ *************************************************/
+#define CLK_MAIN_HZ     20000000UL // メインクロック(水晶)
+#define CLK_PLL_STC     10         // PLL 逓倍率
+#define CLK_PLL_PLIDIV  1          // PLL 入力分周
+#define CLK_ICK_DIV     1          // ICLK  (CPU)
+#define CLK_FCK_DIV     2          // FCLK  (FlashIF)
+#define CLK_BCK_DIV     2          // BCLK  (外部バス. 端子出力は止める)
+#define CLK_PCKB_DIV    2          // PCLKB (CMT, MTU, SCI, RSPI など)
+#define CLK_PCKD_DIV    1          // PCLKD (S12AD)
+
+#define CLK_PLL_HZ      (CLK_MAIN_HZ / (1UL << CLK_PLL_PLIDIV) * CLK_PLL_STC)
+#define CLK_ICLK_HZ     (CLK_PLL_HZ >> CLK_ICK_DIV)
+#define CLK_FCLK_HZ     (CLK_PLL_HZ >> CLK_FCK_DIV)
+#define CLK_BCLK_HZ     (CLK_PLL_HZ >> CLK_BCK_DIV)
+#define CLK_PCLKB_HZ    (CLK_PLL_HZ >> CLK_PCKB_DIV)
+#define CLK_PCLKD_HZ    (CLK_PLL_HZ >> CLK_PCKD_DIV)
+
+// init_CLK が書く値. SCKCR の b23 = PSTOP1 (BCLK 端子出力停止), b12, b4 は 1 を書く.
+#define CLK_PLLCR       (((CLK_PLL_STC - 1) << 8) | CLK_PLL_PLIDIV)
+#define CLK_SCKCR       ((CLK_FCK_DIV * 1UL << 28) | (CLK_ICK_DIV * 1UL << 24) | (1UL << 23) | (CLK_BCK_DIV * 1UL << 16) \
+                       | (1UL << 12) | (CLK_PCKB_DIV * 1UL << 8) | (1UL << 4) | CLK_PCKD_DIV)
+
+#if (CLK_ICLK_HZ > 50000000UL) || (CLK_PCLKB_HZ > 32000000UL) || (CLK_PCLKD_HZ > 50000000UL) || (CLK_FCLK_HZ > 32000000UL)
+#error "RX210 の最大動作周波数を超えている. clock_config.h の分周設定を見直す."
+#endif
+#if (CLK_FCLK_HZ < 4000000UL) || (CLK_FCLK_HZ % 1000000UL)
+#error "データフラッシュの書き込みには FCLK を 4MHz 以上の整数MHz にする (data_flash.h の FCU への通知)"
+#endif
+/********************************************************************************************/
+
+#endif /* CLOCK_CONFIG_H_ */
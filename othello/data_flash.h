@@ -0,0 +1,207 @@
+/*********************************************************************************************/
+//
+//  FILE        : data_flash.h
+//  DATE        : 2025/11/25 Tue.
+//  DESCRIPTION : E2データフラッシュ(8KB)の読み書き
+//  CPU TYPE    : RX Family
+//
+//  Author T.Ijiro
+//
+//  0x00100000 からの 8KB, 128バイト × 64ブロック. 消去はブロック単位, 書き込みは2バイト単位.
+//  書き込み・消去は FCU にコマンドを送って行う. FCU のファームウェアは df_init で FCU RAM に写す.
+//  ・消去したままの領域を読んだ値は不定. 書いたかどうかは df_is_blank (ブランクチェック) で調べる.
+//  ・書き込み・消去の間もプログラム(ROM)は動き, 割込みも入る. データフラッシュは読めない.
+//  ・消去は1ブロック数ms かかり, その間呼んだ側は待つ. 書き換え回数には上限があるので同じブロックばかり書かないこと.
+/************************************************************************************************/
+#ifndef DATA_FLASH_H_
+#define DATA_FLASH_H_
+
+#include <string.h>
+#include "iodefine.h"
+#include "clock_config.h"
+
+/************************************ マクロ *************************************************/
+#define DF_BASE          0x00100000UL // データフラッシュの先頭アドレス
+#define DF_SIZE          8192         // バイト数
+#define DF_BLOCK_SIZE    128          // 消去単位のバイト数
+#define DF_BLOCKS        (DF_SIZE / DF_BLOCK_SIZE)
+#define DF_ADDR(offset)  (DF_BASE + (unsigned long)(offset))
+
+#define DF_FCLK_MHZ      (CLK_FCLK_HZ / 1000000UL) // FlashIF クロック[MHz]
+#define DF_FCU_FIRM_ADDR 0xFEFFE000UL // FCU ファームウェアの格納先
+#define DF_FCU_RAM_ADDR  0x007F8000UL // FCU RAM
+#define DF_FCU_RAM_SIZE  0x2000
+#define DF_TIMEOUT_LOOPS 2000000UL    // FRDY を待つ回数の上限 (消去の最大時間より十分長く)
+/********************************************************************************************/
+
+
+/*************************************** グローバル変数 ***************************************/
+static unsigned char df_ready; // df_init が成功した
+/*************************************************************************************************/
+
+
+/************************************************** 関数定義 **************************************************/
+// FCU が処理を終えるまで待つ. 戻り値 : 0 = 終了, -1 = 時間切れ (FCU をリセットする)
+int df_wait_ready(void)
+{
+    unsigned long n;
+
+    for(n = 0; n < DF_TIMEOUT_LOOPS; n++)
+    {
+        if(FLASH.FSTATR0.BIT.FRDY) return 0;
+    }
+
+    FLASH.FRESETR.WORD = 0xCC01;
+    for(n = 0; n < 100; n++)
+        ;
+    FLASH.FRESETR.WORD = 0xCC00;
+
+    return -1;
+}
+
+// P/E モード(データフラッシュ)に入る
+void df_enter_pe(void)
+{
+    FLASH.FENTRYR.WORD = 0xAA80;
+    while(FLASH.FENTRYR.WORD != 0x0080)
+        ;
+}
+
+// リードモードに戻る. エラーが残っていればステータスクリアしてから戻る.
+void df_exit_pe(void)
+{
+    volatile unsigned char *cmd = (volatile unsigned char *)DF_BASE;
+
+    df_wait_ready();
+
+    if(FLASH.FSTATR0.BIT.ILGLERR || FLASH.FSTATR0.BIT.ERSERR || FLASH.FSTATR0.BIT.PRGERR)
+    {
+        if(FLASH.FSTATR0.BIT.ILGLERR && (FLASH.FASTAT.BYTE != 0x10)) FLASH.FASTAT.BYTE = 0x10;
+        *cmd = 0x50;
+    }
+
+    FLASH.FENTRYR.WORD = 0xAA00;
+    while(FLASH.FENTRYR.WORD != 0x0000)
+        ;
+}
+
+// 直前のコマンドの結果. 戻り値 : 0 = 成功, -1 = 失敗
+int df_result(void)
+{
+    if(df_wait_ready()) return -1;
+
+    if(FLASH.FSTATR0.BIT.ILGLERR || FLASH.FSTATR0.BIT.ERSERR || FLASH.FSTATR0.BIT.PRGERR) return -1;
+
+    return 0;
+}
+
+// データフラッシュを使えるようにする. FCU のファームウェアを写し, FlashIF クロックを知らせる.
+// 2回目からは何もしない. 戻り値 : 0 = 成功, -1 = 失敗
+int df_init(void)
+{
+    volatile unsigned char *cmd = (volatile unsigned char *)DF_BASE;
+    volatile uint16_t      *cmdw = (volatile uint16_t *)DF_BASE;
+    int ret;
+
+    if(df_ready) return 0;
+
+    // 読み出し, 書き込み・消去を全ブロックで許可
+    FLASH.DFLRE0.WORD  = 0x2DFF;
+    FLASH.DFLWE0.WORD  = 0x1EFF;
+    FLASH.FWEPROR.BYTE = 0x01;
+
+    // FCU ファームウェアを FCU RAM へ (リードモードで)
+    if(FLASH.FENTRYR.WORD != 0x0000)
+    {
+        FLASH.FENTRYR.WORD = 0xAA00;
+        while(FLASH.FENTRYR.WORD != 0x0000)
+            ;
+    }
+    FLASH.FCURAME.WORD = 0xC401;
+    memcpy((void *)DF_FCU_RAM_ADDR, (const void *)DF_FCU_FIRM_ADDR, DF_FCU_RAM_SIZE);
+
+    // 周辺クロック通知コマンド
+    df_enter_pe();
+    FLASH.PCKAR.WORD = DF_FCLK_MHZ;
+    *cmd  = 0xE9;
+    *cmd  = 0x03;
+    *cmdw = 0x0F0F;
+    *cmdw = 0x0F0F;
+    *cmdw = 0x0F0F;
+    *cmd  = 0xD0;
+    ret = df_result();
+    df_exit_pe();
+
+    df_ready = (ret == 0);
+
+    return ret;
+}
+
+// ブロックを消去する. 戻り値 : 0 = 成功, -1 = 失敗
+int df_erase(unsigned int block)
+{
+    volatile unsigned char *cmd = (volatile unsigned char *)DF_ADDR(block * DF_BLOCK_SIZE);
+    int ret;
+
+    df_enter_pe();
+    *cmd = 0x20;
+    *cmd = 0xD0;
+    ret = df_result();
+    df_exit_pe();
+
+    return ret;
+}
+
+// offset から bytes バイト書く. offset, bytes は偶数. 書く先は消去してあること.
+// 戻り値 : 0 = 成功, -1 = 失敗
+int df_write(unsigned int offset, const void *data, unsigned int bytes)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    volatile unsigned char *cmd;
+    int ret = 0;
+
+    df_enter_pe();
+
+    for(; bytes >= 2; bytes -= 2, offset += 2, p += 2)
+    {
+        cmd = (volatile unsigned char *)DF_ADDR(offset);
+
+        *cmd = 0xE8;
+        *cmd = 0x01;
+        *(volatile uint16_t *)cmd = (uint16_t)(p[0] | (p[1] << 8));
+        *cmd = 0xD0;
+
+        ret = df_result();
+        if(ret) break;
+    }
+
+    df_exit_pe();
+
+    return ret;
+}
+
+// ブロックが消去したままか (ブランクチェック). 戻り値 : 1 = 消去したまま, 0 = 書いてある, -1 = 失敗
+int df_is_blank(unsigned int block)
+{
+    volatile unsigned char *cmd = (volatile unsigned char *)DF_ADDR(block * DF_BLOCK_SIZE);
+    int ret;
+
+    df_enter_pe();
+    FLASH.DFLBCCNT.BIT.BCSIZE = 1; // ブロック全体
+    *cmd = 0x71;
+    *cmd = 0xD0;
+    ret = df_result();
+    if(!ret) ret = FLASH.DFLBCSTAT.BIT.BCST ? 0 : 1;
+    df_exit_pe();
+
+    return ret;
+}
+
+// offset から bytes バイト読む. 書いてある所だけ読むこと.
+void df_read(unsigned int offset, void *data, unsigned int bytes)
+{
+    memcpy(data, (const void *)DF_ADDR(offset), bytes);
+}
+/*************************************************************************************************/
+
+#endif /* DATA_FLASH_H_ */
@@ -0,0 +1,30 @@
+/*
+ *  eval_weights.h
+ *
+ *  評価関数の重み係数と盤面のスコア定義.
+ *  host/tune_eval で棋譜から再生成できる. 手で変えるときは盤面の対称性(8通り)を保つこと.
+ *  MAT_WIDTH, MAT_HEIGHT を定義してからインクルードする.
+ */
+
+#ifndef EVAL_WEIGHTS_H_
+#define EVAL_WEIGHTS_H_
+
+// 評価関数の重み係数定義. どの要素をどれくらい重要視するか.
+#define POS_WEIGHT      7   // 位置評価の重み係数
+#define MOBILITY_WEIGHT 3   // 配置可能数評価の重み係数
+#define STABLE_WEIGHT   30  // 確定石数（４つ角）評価の重み係数
+
+// 盤面のスコア定義
+static const int POSITION_WEIGHTS[MAT_HEIGHT][MAT_WIDTH] =
+{
+    {120, -40,  20,  10,  10,  20, -40, 120},
+    {-40, -50,  -5,  -5,  -5,  -5, -50, -40},
+    { 20,  -5,  15,  10,  10,  15,  -5,  20},
+    { 10,  -5,  10,   5,   5,  10,  -5,  10},
+    { 10,  -5,  10,   5,   5,  10,  -5,  10},
+    { 20,  -5,  15,  10,  10,  15,  -5,  20},
+    {-40, -50,  -5,  -5,  -5,  -5, -50, -40},
+    {120, -40,  20,  10,  10,  20, -40, 120}
+};
+
+#endif /* EVAL_WEIGHTS_H_ */
@@ -0,0 +1,269 @@
+/*********************************************************************************************/
+//
+//  FILE        : bench_suite.c
+//  DATE        : 2025/11/25 Tue.
+//  DESCRIPTION : 局面集ベンチマーク(ホストPC用)
+//  CPU TYPE    : ホストPC
+//
+//  Author T.Ijiro
+//
+//  ビルド・実行 (othello/host で)
+//    gcc -O2 -I.. -o bench_suite bench_suite.c
+//    ./bench_suite        : 全局面を探索して最善手・評価値を照合し, 時間とノード数を表示
+//    ./bench_suite -u     : 現在の結果で BENCH_SUITE を書き直すためのソースを出力
+//    ./bench_suite -s     : 8通りの向きで正規形と探索結果が一致するかを確認
+//    ./bench_suite -m     : AI_DEPTH ごとのAI用バッファのバイト数を表示(深さを上げる前に RAM に入るか見る)
+//
+//  FFO形式(盤面文字列 + 手番 + 期待する最善手と評価値)の局面集.
+//  中盤から終盤(44〜10空き)の局面を並べている.
+//  minimax_alphabeta を速くする変更は, 最善手と評価値を一切変えずにノード数か時間を減らすこと.
+//  評価関数を意図して変えたときは -u の出力で期待値を更新する.
+//
+//  盤面文字列 : brd[y][x] を y = 0..7, x = 0..7 の順に並べた64文字
+//               'R' = stone_red, 'G' = stone_green, '-' = stone_black
+/************************************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "othello_ai.h"
+#include "othello_sym.h"
+
+/************************************ マクロ *************************************************/
+#define BENCH_DEPTH AI_DEPTH // 実機と同じ先読み
+/********************************************************************************************/
+
+
+/**************************************** 型定義 ********************************************/
+// ベンチマーク局面
+struct BenchPos{
+    const char       *board;  // 盤面文字列
+    enum stone_color  color;  // 手番
+    int               best_x; // 期待する最善手のx座標
+    int               best_y; // 期待する最善手のy座標
+    int               score;  // 期待する評価値
+};
+/****************************************************************************************/
+
+
+/********************************************* 定数 *************************************************/
+static const struct BenchPos BENCH_SUITE[] =
+{
+    {"-------G-GGGG-G----R-GR---GRRRG----RRR-----R------R------R------", stone_red,   5, 1,  -497}, // 44 empties
+    {"-R-----G-GRGGRGG---G-GG--RGRGGG--GGGGGG---GRRRGR-GGG-RG--R------", stone_red,   4, 2,    83}, // 28 empties
+    {"-RRR-G-G-GGRGGGG--GRGGG--RGRRRGG-GGRGRG---GRGGRR-GGRGGRR-R-R--R-", stone_red,   4, 0,  -964}, // 18 empties
+    {"-RRRRG-G-GGRRGGGG-GRRRGG-GGRRRGG-GGRRGRR--GRGGRR-GGGRRRR-RGRR-R-", stone_red,   0, 5, -1381}, // 12 empties
+    {"-------------GG----RGGR---RRGR---RRGRGR--GGRGRG--GRRRRR---------", stone_red,   5, 0,    57}, // 36 empties
+    {"-RG-G----RG-GGG-RRGRGRR---GGGRR--RGGGGR--GGGRGG--GGRRGGG--RRR---", stone_red,   1, 3,   752}, // 22 empties
+    {"-RRRG---GRRRRGG-GGRRRRG-GRGRRRRGGGGGGGG-GGRRRGG--GGRRGGG--RRR---", stone_red,   5, 0,   974}, // 14 empties
+    {"-RRRGG--GRRRGGGGGGRGRRGRGRGRRGRRGGGGGGGRGGRRRGR--GGRRRGG--RRR---", stone_red,   7, 5,   551}, // 10 empties
+    {"------------G-G--RRGRRRR--RRRRG--GRGR------G--------------------", stone_green, 1, 3,  -707}, // 45 empties
+    {"---R-R---R-RR-R-RRRRGRRRGGGRRGG--GGRGG----RGGG---RG-G---R-G-----", stone_green, 2, 1,  -314}, // 29 empties
+    {"---RRR--GR-RRRRGGGRRRRGRGGGRRGR--GGRGGRR--RGRR-RGGG-GRR-R-G-----", stone_green, 7, 3, -1454}, // 19 empties
+    {"---RRR--GR-RRRRGGRRRRRRGGRGRRGRGRRRRGRRR-RRRRRRRGRGGGRR-RRG-----", stone_green, 6, 0,  -363}, // 13 empties
+    {"----------RGG-G--GGRGGGG-RGRRGG----GGRGG---R--R---RRR-----------", stone_green, 4, 5,  -182}, // 37 empties
+    {"---G------GGG-GR-GRGGGRR-GGRRRRRGGGGRGGR--GGRRRR--GGGGR---GG----", stone_green, 7, 6, -1168}, // 23 empties
+    {"---G----R-GGG-GR-RRGGGRR-GRGRRRRGGGRRGGRGGRRRRGRGGGGGGGG--GG--GR", stone_green, 7, 0, -2831}, // 15 empties
+    {"---G---GRRRRRRGGRGGGRRRG-GRRRRRGGGRRRGGGGGRRRRGGGGGGGGGG--GG--GR", stone_green, 6, 0, -1208}  // 11 empties
+};
+
+#define BENCH_SUITE_SIZE ((int)(sizeof(BENCH_SUITE) / sizeof(BENCH_SUITE[0])))
+/*******************************************************************************************/
+
+
+/************************************************** 関数定義 **************************************************/
+// 盤面文字列を盤面に展開
+void parse_board(const char *str, enum stone_color brd[][MAT_WIDTH])
+{
+    int x, y;
+
+    for(y = 0; y < MAT_HEIGHT; y++)
+    {
+        for(x = 0; x < MAT_WIDTH; x++)
+        {
+            switch(str[y * MAT_WIDTH + x])
+            {
+                case 'R': place(brd, x, y, stone_red);   break;
+                case 'G': place(brd, x, y, stone_green); break;
+                default:  delete(brd, x, y);             break;
+            }
+        }
+    }
+}
+
+// 空きマスの数
+int count_empties(enum stone_color brd[][MAT_WIDTH])
+{
+    return count_stones(brd, stone_black);
+}
+
+// ルートの候補手から最善手を選ぶ. 同点は生成順で最初の手.
+int pick_best_move(void)
+{
+    int i, best_idx = 0;
+
+    for(i = 1; i < ai_move_counts[0]; i++)
+    {
+        if(ai_moves[0][i].score > ai_moves[0][best_idx].score)
+        {
+            best_idx = i;
+        }
+    }
+
+    return best_idx;
+}
+
+// 対称変換した盤面を作る
+void transform_board(enum stone_color src[][MAT_WIDTH], enum stone_color dst[][MAT_WIDTH], int sym)
+{
+    int x, y, tx, ty;
+
+    for(y = 0; y < MAT_HEIGHT; y++)
+    {
+        for(x = 0; x < MAT_WIDTH; x++)
+        {
+            tx = x;
+            ty = y;
+            sym_to_canonical_xy(sym, &tx, &ty);
+            dst[ty][tx] = src[y][x];
+        }
+    }
+}
+
+// 8通りの向きで正規形が同じになり, 探索の評価値と最善手の評価値が変わらないか確認する.
+// 戻り値 : 不一致の数
+int check_symmetry(void)
+{
+    enum stone_color board[MAT_HEIGHT][MAT_WIDTH], t[MAT_HEIGHT][MAT_WIDTH];
+    struct BitBoard canon, c;
+    uint64_t hash, h;
+    int i, j, sym, x, y, score, ok;
+    int failed = 0;
+
+    for(i = 0; i < BENCH_SUITE_SIZE; i++)
+    {
+        parse_board(BENCH_SUITE[i].board, board);
+        canonicalize(board, &canon, &hash);
+
+        for(sym = 0; sym < SYM_COUNT; sym++)
+        {
+            transform_board(board, t, sym);
+            canonicalize(t, &c, &h);
+            score = minimax_alphabeta(t, BENCH_SUITE[i].color, BENCH_DEPTH);
+
+            // 期待する最善手を変換後の座標にして, その手の評価値を探す
+            x = BENCH_SUITE[i].best_x;
+            y = BENCH_SUITE[i].best_y;
+            sym_to_canonical_xy(sym, &x, &y);
+
+            ok = (c.red == canon.red) && (c.green == canon.green) && (h == hash) && (score == BENCH_SUITE[i].score);
+
+            for(j = 0; j < ai_move_counts[0]; j++)
+            {
+                if(ai_moves[0][j].x == x && ai_moves[0][j].y == y) break;
+            }
+
+            ok = ok && (j < ai_move_counts[0]) && (ai_moves[0][j].score == score);
+
+            if(!ok)
+            {
+                printf("%2d sym %d : NG\n", i + 1, sym);
+                failed++;
+            }
+        }
+    }
+
+    printf("symmetry %d/%d OK\n", BENCH_SUITE_SIZE * SYM_COUNT - failed, BENCH_SUITE_SIZE * SYM_COUNT);
+
+    return failed;
+}
+
+// 先読みの回数ごとのAI用バッファのバイト数を表示する. 使う型のサイズはRX(CC-RX)と同じ.
+void print_memory_report(void)
+{
+    int d;
+
+    printf("AI memory [byte] (EVAL_CACHE_BITS %d, * = AI_DEPTH)\n", EVAL_CACHE_BITS);
+    printf("depth   ai_buf  ai_moves  counts  eval_cache  static total  stack_*\n");
+
+    for(d = 1; d <= 10; d++)
+    {
+        printf("%c%4d %8lu  %8lu  %6lu  %10lu  %12lu  %7lu\n", (d == AI_DEPTH) ? '*' : ' ', d,
+               (unsigned long)AI_BUF_BYTES(d), (unsigned long)AI_MOVES_BYTES(d),
+               (unsigned long)AI_MOVE_COUNTS_BYTES(d), (unsigned long)EVAL_CACHE_BYTES,
+               (unsigned long)AI_STATIC_BYTES(d), (unsigned long)AI_STACK_BYTES(d));
+    }
+}
+/*************************************************************************************************/
+
+
+/******************************************** メイン ***********************************************/
+int main(int argc, char *argv[])
+{
+    enum stone_color board[MAT_HEIGHT][MAT_WIDTH];
+    int update = (argc > 1) && (strcmp(argv[1], "-u") == 0);
+    int i, best_idx, score, ok;
+    int failed = 0;
+    unsigned long total_nodes = 0;
+    double sec, total_sec = 0.0;
+    clock_t start;
+
+    if((argc > 1) && (strcmp(argv[1], "-s") == 0))
+    {
+        return check_symmetry() ? 1 : 0;
+    }
+
+    if((argc > 1) && (strcmp(argv[1], "-m") == 0))
+    {
+        print_memory_report();
+        return 0;
+    }
+
+    if(!update)
+    {
+        printf("depth %d\n", BENCH_DEPTH);
+        printf(" #  empties  move    score  expect          nodes     time[ms]  result\n");
+    }
+
+    for(i = 0; i < BENCH_SUITE_SIZE; i++)
+    {
+        const struct BenchPos *p = &BENCH_SUITE[i];
+
+        parse_board(p->board, board);
+
+        start = clock();
+        score = minimax_alphabeta(board, p->color, BENCH_DEPTH);
+        sec = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        best_idx = pick_best_move();
+
+        if(update)
+        {
+            printf("    {\"%s\", %-12s %d, %d, %5d}%s // %d empties\n",
+                   p->board, (p->color == stone_red) ? "stone_red," : "stone_green,",
+                   ai_moves[0][best_idx].x, ai_moves[0][best_idx].y, score,
+                   (i == BENCH_SUITE_SIZE - 1) ? " " : ",", count_empties(board));
+            continue;
+        }
+
+        ok = (ai_moves[0][best_idx].x == p->best_x) && (ai_moves[0][best_idx].y == p->best_y) && (score == p->score);
+        failed += !ok;
+
+        total_nodes += ai_node_count;
+        total_sec   += sec;
+
+        printf("%2d  %7d  (%d,%d)  %6d  (%d,%d) %6d  %9lu  %10.2f  %s\n",
+               i + 1, count_empties(board), ai_moves[0][best_idx].x, ai_moves[0][best_idx].y, score,
+               p->best_x, p->best_y, p->score, ai_node_count, sec * 1000.0, ok ? "OK" : "NG");
+    }
+
+    if(update) return 0;
+
+    printf("total nodes %lu, time %.2f ms, %.0f nodes/s, %d/%d OK\n",
+           total_nodes, total_sec * 1000.0, (total_sec > 0.0) ? total_nodes / total_sec : 0.0,
+           BENCH_SUITE_SIZE - failed, BENCH_SUITE_SIZE);
+    printf("eval cache %d entries, hit %lu, miss %lu (%.1f%%)\n",
+           EVAL_CACHE_SIZE, eval_cache_hits, eval_cache_misses,
+           100.0 * eval_cache_hits / ((eval_cache_hits + eval_cache_misses) ? (eval_cache_hits + eval_cache_misses) : 1));
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+/*********************************************************************************************/
+//
+//  FILE        : check_matrix_out.c
+//  DATE        : 2025/11/25 Tue.
+//  DESCRIPTION : マトリックスLED出力のビット順確認(ホストPC用)
+//  CPU TYPE    : ホストPC
+//
+//  Author T.Ijiro
+//
+//  ビルド・実行 (othello/host で)
+//    gcc -O2 -Irx_mock -I.. -o check_matrix_out check_matrix_out.c
+//    ./check_matrix_out
+//
+//  74HC595 2段のシフトレジスタをモデル化し, 全ての赤緑データ(65536通り)について
+//  ソフトウェア出力(col_out)と RSPI0 + DTC 出力でラッチされる値と点灯列が一致するか確認する.
+//  RSPI0 と DTC はモックのレジスタに書かれた設定(ビット数, ビット順, クロック位相,
+//  SSL極性, 転送情報)を読んで動かすので, 設定の誤りもビット列の違いとして見つかる.
+/************************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+
+/************************************ マクロ *************************************************/
+// 両方の出力を比べるので, RSPI0 + DTC 側も matrix_out.h から取り込む
+#ifndef MATRIX_OUT_RSPI
+#define MATRIX_OUT_RSPI
+#endif
+
+// ソフトウェア出力の端子操作をシフトレジスタのモデルにつなぐ
+#define SERIAL_SINK    do { hc595_ser = 0; } while(0)
+#define SERIAL_SOURCE  do { hc595_ser = 1; } while(0)
+#define SEND_LATCH_CLK do { hc595_shift(&sw_chain, hc595_ser); } while(0)
+#define LATCH_OUT      do { hc595_latch(&sw_chain); } while(0)
+#define COL_EN         mock_col_en
+/********************************************************************************************/
+
+
+/**************************************** 型定義 ********************************************/
+// 74HC595 2段. ビット i = i 段目 (ビット0 = 1段目のQA, ビット15 = 2段目のQH)
+struct Hc595Chain{
+    uint16_t sr;  // シフトレジスタ
+    uint16_t out; // ストレージレジスタ(出力)
+};
+/****************************************************************************************/
+
+
+/*************************************** グローバル変数 ***************************************/
+static int               hc595_ser;   // SER 端子
+static struct Hc595Chain sw_chain;    // ソフトウェア出力側
+static struct Hc595Chain spi_chain;   // RSPI0 出力側
+static unsigned char     mock_col_en; // 点灯列許可
+/*************************************************************************************************/
+
+
+/*************************************** プロトタイプ宣言 ***************************************/
+void hc595_shift(struct Hc595Chain *c, int ser);
+void hc595_latch(struct Hc595Chain *c);
+/*************************************************************************************************/
+
+
+// モックの iodefine.h (rx_mock/) と MAT_WIDTH を使うので後でインクルードする
+#include "othello_ai.h"
+#include "matrix_out.h"
+
+
+/************************************************** 関数定義 **************************************************/
+// SRCLK の立ち上がり
+void hc595_shift(struct Hc595Chain *c, int ser)
+{
+    c->sr = (uint16_t)((c->sr << 1) | (ser & 1));
+}
+
+// RCLK の立ち上がり
+void hc595_latch(struct Hc595Chain *c)
+{
+    c->out = c->sr;
+}
+
+// SPCMD0.SPB からフレームのビット数を求める
+int rspi_frame_bits(int spb)
+{
+    if(spb >= 0x8) return spb + 1;   // 9〜16ビット
+    if(spb >= 0x4) return 8;
+    if(spb == 0x0) return 20;
+    if(spb == 0x1) return 24;
+
+    return 32;
+}
+
+// RSPI0 の設定で SPDR の値を送る. 戻り値 : 設定の誤りの数
+int rspi_send(struct Hc595Chain *c)
+{
+    uint32_t data = RSPI0.SPDR.WORD.H;
+    int bits = rspi_frame_bits(RSPI0.SPCMD0.BIT.SPB);
+    int i, bit, errors = 0;
+
+    // マスタで動いていて, SRCLK の立ち上がりでデータが確定していること
+    if(!RSPI0.SPCR.BIT.SPE || !RSPI0.SPCR.BIT.MSTR)       errors++;
+    if(RSPI0.SPCMD0.BIT.CPOL || RSPI0.SPCMD0.BIT.CPHA)     errors++;
+
+    for(i = 0; i < bits; i++)
+    {
+        bit = RSPI0.SPCMD0.BIT.LSBF ? i : (bits - 1 - i);
+        hc595_shift(c, (int)(data >> bit) & 1);
+    }
+
+    // SSL0 は負論理のときだけネゲートが RCLK の立ち上がりになる
+    if(!RSPI0.SSLP.BIT.SSL0P)
+    {
+        hc595_latch(c);
+    }
+    else
+    {
+        errors++;
+    }
+
+    return errors;
+}
+
+// CMT1 CMI1 で DTC が1回転送する. 転送情報の内容どおりに動かす.
+// 戻り値 : 設定の誤りの数
+int dtc_transfer(uint32_t *src_idx)
+{
+    struct DtcInfo *info = &matrix_dtc_info;
+    unsigned int mra = info->mode >> 24;
+    unsigned int mrb = (info->mode >> 16) & 0xFF;
+    unsigned int cral = (info->count >> 16) & 0xFF;
+    int errors = 0;
+
+    if(!DTC.DTCST.BIT.DTCST || !DTCE(CMT1, CMI1) || !IEN(CMT1, CMI1))                 errors++;
+    if(matrix_dtc_vect[VECT(CMT1, CMI1)] != (uint32_t)(uintptr_t)&matrix_dtc_info)     errors++;
+    if(info->sar != (uint32_t)(uintptr_t)matrix_tx_buf)                                 errors++;
+    if(info->dar != (uint32_t)(uintptr_t)&RSPI0.SPDR)                                   errors++;
+    if((mra & 0xC0) != DTC_MRA_MD_REPEAT || (mra & 0x30) != DTC_MRA_SZ_WORD)           errors++;
+    if((mra & 0x0C) != DTC_MRA_SM_INC || (mrb & 0x1C) != (DTC_MRB_DTS_SRC | DTC_MRB_DM_FIXED)) errors++;
+    if(cral != MATRIX_COLS)                                                             errors++;
+
+    RSPI0.SPDR.WORD.H = matrix_tx_buf[*src_idx];
+
+    // リピート領域の先頭に戻る
+    *src_idx = (*src_idx + 1) % cral;
+
+    return errors;
+}
+
+// 出力が吸い込み(0)になっている段の数
+int count_sink(uint16_t out)
+{
+    int i, n = 0;
+
+    for(i = 0; i < MATRIX_BITS; i++)
+    {
+        n += !((out >> i) & 1);
+    }
+
+    return n;
+}
+/*************************************************************************************************/
+
+
+/******************************************** メイン ***********************************************/
+int main(void)
+{
+    unsigned int base, rg_data;
+    uint32_t src_idx = 0;
+    int x, col, bit, errors = 0, mismatch = 0;
+    uint16_t sw_out[MATRIX_COLS];
+
+    init_matrix_rspi();
+    init_matrix_dtc();
+    IEN(CMT1, CMI1) = 1;   // init_CMT1 の代わり
+    RSPI0.SPSR.BIT.IDLNF = 0;
+
+    // 1段目のQAから順に, どの赤緑ビットが出るか
+    col_out(0, 0);
+    printf("stage : ");
+    for(bit = 0; bit < MATRIX_BITS; bit++)
+    {
+        col_out(0, 1u << bit);
+        for(x = 0; x < MATRIX_BITS; x++)
+        {
+            if(!((sw_chain.out >> x) & 1)) printf("Q%d=%c%d ", x, (bit >= 8) ? 'R' : 'G', bit & 7);
+        }
+    }
+    printf("\n");
+
+    for(base = 0; base < 0x10000; base += MATRIX_COLS)
+    {
+        // ソフトウェア出力
+        for(x = 0; x < MATRIX_COLS; x++)
+        {
+            rg_data = base + x;
+            col_out(x, rg_data);
+            sw_out[x] = sw_chain.out;
+
+            if(mock_col_en != (1 << x) || count_sink(sw_out[x]) != __builtin_popcount(rg_data)) mismatch++;
+
+            matrix_rspi_set_col(x, rg_data);
+        }
+
+        // RSPI0 + DTC 出力
+        for(x = 0; x < MATRIX_COLS; x++)
+        {
+            errors += dtc_transfer(&src_idx);
+            errors += rspi_send(&spi_chain);
+            col = matrix_rspi_col_done();
+
+            if(col != x || mock_col_en != (1 << x) || spi_chain.out != sw_out[x]) mismatch++;
+        }
+    }
+
+    printf("register errors %d, mismatched columns %d\n", errors, mismatch);
+    printf("%s\n", (errors || mismatch) ? "NG" : "OK");
+
+    return (errors || mismatch) ? 1 : 0;
+}
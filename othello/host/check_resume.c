@@ -0,0 +1,309 @@
+/*********************************************************************************************/
+//
+//  FILE        : check_resume.c
+//  DATE        : 2025/11/25 Tue.
+//  DESCRIPTION : 中断局面の保存の電源断確認(ホストPC用)
+//  CPU TYPE    : ホストPC
+//
+//  Author T.Ijiro
+//
+//  ビルド・実行 (othello/host で)
+//    gcc -O2 -I.. -o check_resume check_resume.c
+//    ./check_resume [-n 書く回数] [-s シード]
+//
+//  resume_flash.h の resume_init, resume_write をE2データフラッシュのモデルの上で動かし,
+//  書き込み・消去の途中で電源を切っては起動し直す. 確かめること :
+//  ・起動後に見つかる局面は, 最後に書き終えた局面か書いていた局面で, 中身が一致する
+//  ・消去し終えてから書いていない所にしか書かない
+//  ・消去はブロックの先頭のスロットを書くときだけで, 一番新しい局面のあるブロックは消去しない
+//  ・通し番号が16ビットで一周しても一番新しい局面を選ぶ (既定の回数で3周する)
+//  最初の中身, 消去を中断したブロック, 書きかけの2バイトは乱数で埋め, 読んだ値が不定なのを真似る.
+/************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <stdint.h>
+
+/************************************ マクロ *************************************************/
+// data_flash.h の代わりに下のモデルを使う
+#define DATA_FLASH_H_
+#define DF_SIZE       8192
+#define DF_BLOCK_SIZE 128
+#define DF_BLOCKS     (DF_SIZE / DF_BLOCK_SIZE)
+
+#define WRITES_DEFAULT   200000 // 既定の書く回数
+#define CUT_ONE_IN       8      // この回数に1回, 書いている途中で電源を切る
+#define CUT_UNIT_ONE_IN  10     // 電源を切る回は, 書き込み・消去の単位ごとに 1 / この値 の確率で切る
+#define CLEAN_BOOT_EVERY 1000   // この回数ごとに電源断なしで起動し直す
+#define CLEAR_EVERY      50     // この回数ごとに終わった局面(flags = 0)を書く (resume_clear)
+/********************************************************************************************/
+
+
+/**************************************** 型定義 ********************************************/
+// E2データフラッシュのモデル
+struct FlashModel{
+    unsigned char mem[DF_SIZE];            // 読める値
+    unsigned char programmed[DF_SIZE / 2]; // 消去してから書いた(書きかけを含む)2バイト
+    unsigned char erased[DF_BLOCKS];       // 最後の消去を終えたブロック
+};
+/****************************************************************************************/
+
+
+/*************************************** プロトタイプ宣言 ***************************************/
+int  df_init(void);
+int  df_erase(unsigned int block);
+int  df_write(unsigned int offset, const void *data, unsigned int bytes);
+int  df_is_blank(unsigned int block);
+void df_read(unsigned int offset, void *data, unsigned int bytes);
+/*************************************************************************************************/
+
+
+// DF_* とモデルの df_* を使うので後でインクルードする
+#include "resume_flash.h"
+
+
+/*************************************** グローバル変数 ***************************************/
+static struct FlashModel     flash;
+static jmp_buf               power_cut;         // 電源断で戻る所
+static int                   power_armed;       // 今の resume_write の途中で電源を切る
+static struct ResumeSnapshot snap;              // 書いている局面
+static unsigned int          snap_slot;         // snap を書くスロット
+static struct ResumeSnapshot committed;         // 書き終えた一番新しい局面
+static int                   have_committed;    // committed がある
+static int                   newest_block = -1; // committed のあるブロック (RESUME_DF_FIRST_BLOCK から)
+static unsigned long         cuts, boots, erases, errors;
+/*************************************************************************************************/
+
+
+/************************************************** データフラッシュのモデル **************************************************/
+// 書き込み・消去の単位ごとに呼ぶ. 戻り値 : 1 = ここで電源が切れる
+int power_fails(void)
+{
+    return power_armed && (rand() % CUT_UNIT_ONE_IN == 0);
+}
+
+void fill_random(unsigned char *p, unsigned int bytes)
+{
+    while(bytes--) *p++ = (unsigned char)rand();
+}
+
+int df_init(void)
+{
+    return 0;
+}
+
+int df_erase(unsigned int block)
+{
+    erases++;
+
+    if((resume_next % RESUME_SLOTS_PER_BLOCK != 0) || (block != RESUME_DF_FIRST_BLOCK + resume_next / RESUME_SLOTS_PER_BLOCK))
+    {
+        printf("erase of block %u while writing slot %u\n", block, resume_next);
+        errors++;
+    }
+
+    if(have_committed && ((int)block == RESUME_DF_FIRST_BLOCK + newest_block))
+    {
+        printf("erase of block %u holding the newest snapshot (seq %u)\n", block, committed.seq);
+        errors++;
+    }
+
+    // 消去の途中で切れたら中身は不定で, 消去し終えてもいない
+    flash.erased[block] = 0;
+    fill_random(&flash.mem[block * DF_BLOCK_SIZE], DF_BLOCK_SIZE);
+    if(power_fails())
+    {
+        cuts++;
+        longjmp(power_cut, 1);
+    }
+
+    memset(&flash.programmed[block * DF_BLOCK_SIZE / 2], 0, DF_BLOCK_SIZE / 2);
+    flash.erased[block] = 1;
+
+    return 0;
+}
+
+int df_write(unsigned int offset, const void *data, unsigned int bytes)
+{
+    const unsigned char *p = (const unsigned char *)data;
+
+    for(; bytes >= 2; bytes -= 2, offset += 2, p += 2)
+    {
+        if(!flash.erased[offset / DF_BLOCK_SIZE] || flash.programmed[offset / 2])
+        {
+            printf("write to 0x%04X, not erased since the last write\n", offset);
+            errors++;
+        }
+
+        flash.programmed[offset / 2] = 1;
+
+        // 書き込みの途中で切れたらその2バイトは不定
+        if(power_fails())
+        {
+            fill_random(&flash.mem[offset], 2);
+            cuts++;
+            longjmp(power_cut, 1);
+        }
+
+        flash.mem[offset]     = p[0];
+        flash.mem[offset + 1] = p[1];
+    }
+
+    return 0;
+}
+
+// 消去し終えてから1度も書いていなければブランク
+int df_is_blank(unsigned int block)
+{
+    unsigned int i;
+
+    if(!flash.erased[block]) return 0;
+
+    for(i = 0; i < DF_BLOCK_SIZE / 2; i++)
+    {
+        if(flash.programmed[block * DF_BLOCK_SIZE / 2 + i]) return 0;
+    }
+
+    return 1;
+}
+
+void df_read(unsigned int offset, void *data, unsigned int bytes)
+{
+    memcpy(data, &flash.mem[offset], bytes);
+}
+/*************************************************************************************************/
+
+
+/************************************************** 確認 **************************************************/
+// 局面の中身 (構造体の詰め物を除く) が同じか
+int same_snapshot(const struct ResumeSnapshot *a, const struct ResumeSnapshot *b)
+{
+    return memcmp(a, b, offsetof(struct ResumeSnapshot, check) + sizeof(a->check)) == 0;
+}
+
+// n 回目に書く局面を作る
+void make_snapshot(unsigned long n)
+{
+    unsigned long h = n * 2654435761UL;
+
+    memset(&snap, 0, sizeof(snap));
+    snap.board.red[0]   = (uint32_t)h;
+    snap.board.red[1]   = (uint32_t)(h >> 7);
+    snap.board.green[0] = (uint32_t)~h;
+    snap.board.green[1] = (uint32_t)(n);
+    snap.color          = (unsigned char)(n & 1);
+    snap.cursor         = (unsigned char)(n % 64);
+    snap.flags          = (n % CLEAR_EVERY == 0) ? 0 : (unsigned char)(RESUME_ACTIVE | (n & RESUME_SKIP));
+}
+
+// 起動し直して一番新しい局面を探し, 書き終えた局面か書いていた局面(cut = 1 のとき)と比べる
+void reboot(int cut)
+{
+    resume_ok     = 0;
+    resume_active = 0;
+    resume_seq    = 0;
+    resume_next   = 0;
+    memset(&resume_last, 0, sizeof(resume_last));
+
+    resume_init();
+    boots++;
+
+    if(resume_last.magic != RESUME_MAGIC)
+    {
+        // 見つからない. 書き終えた局面が無いときだけよい.
+        if(have_committed)
+        {
+            printf("boot %lu: no snapshot, expected seq %u\n", boots, committed.seq);
+            errors++;
+        }
+        return;
+    }
+
+    if(cut && same_snapshot(&resume_last, &snap))
+    {
+        // magic の書き込みが切れる前に終わっていた
+        committed      = snap;
+        have_committed = 1;
+        newest_block   = (int)(snap_slot / RESUME_SLOTS_PER_BLOCK);
+    }
+    else if(!have_committed || !same_snapshot(&resume_last, &committed))
+    {
+        printf("boot %lu: found seq %u, expected seq %u\n", boots, resume_last.seq, committed.seq);
+        errors++;
+        return;
+    }
+
+    if(resume_seq != (uint16_t)(committed.seq + 1) || resume_active != ((committed.flags & RESUME_ACTIVE) != 0))
+    {
+        printf("boot %lu: next seq %u, active %d after seq %u\n", boots, resume_seq, resume_active, committed.seq);
+        errors++;
+    }
+
+    // 次は一番新しい局面の次のブロックの先頭
+    if(resume_next != (unsigned int)((newest_block + 1) % RESUME_DF_BLOCKS) * RESUME_SLOTS_PER_BLOCK)
+    {
+        printf("boot %lu: next slot %u after block %d\n", boots, resume_next, newest_block);
+        errors++;
+    }
+}
+
+void usage(void)
+{
+    fprintf(stderr, "usage: check_resume [-n writes] [-s seed]\n");
+    exit(1);
+}
+/*************************************************************************************************/
+
+
+/******************************************** メイン ***********************************************/
+int main(int argc, char *argv[])
+{
+    volatile unsigned long writes = WRITES_DEFAULT; // setjmp をまたぐので volatile
+    volatile unsigned long n;
+    int i;
+
+    srand(1);
+
+    for(i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)      writes = strtoul(argv[++i], 0, 10);
+        else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc) srand((unsigned)atoi(argv[++i]));
+        else                                                usage();
+    }
+
+    // 一度も消去していないデータフラッシュから
+    fill_random(flash.mem, sizeof(flash.mem));
+    reboot(0);
+
+    for(n = 0; n < writes; n++)
+    {
+        make_snapshot(n);
+        snap_slot = resume_next;
+
+        if(setjmp(power_cut) == 0)
+        {
+            power_armed = (rand() % CUT_ONE_IN == 0);
+            resume_write(&snap);
+            power_armed = 0;
+
+            committed      = snap;
+            have_committed = 1;
+            newest_block   = (int)(snap_slot / RESUME_SLOTS_PER_BLOCK);
+
+            if(n % CLEAN_BOOT_EVERY == CLEAN_BOOT_EVERY - 1) reboot(0);
+        }
+        else
+        {
+            power_armed = 0;
+            reboot(1);
+        }
+    }
+
+    printf("writes %lu, power cuts %lu, boots %lu, erases %lu, last seq %u\n",
+           writes, cuts, boots, erases, have_committed ? committed.seq : 0);
+    printf("errors %lu\n", errors);
+    printf("%s\n", errors ? "NG" : "OK");
+
+    return errors ? 1 : 0;
+}
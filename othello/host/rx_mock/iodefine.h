@@ -0,0 +1,84 @@
+/*********************************************************************************************/
+//
+//  FILE        : iodefine.h (ホストPC用モック)
+//  DATE        : 2025/11/25 Tue.
+//  DESCRIPTION : matrix_out.h が使うRX210レジスタだけを変数で置き換えたモック
+//  CPU TYPE    : ホストPC
+//
+//  Author T.Ijiro
+//
+//  ビット名とアクセス幅は RX210 の iodefine.h に合わせている.
+//  書き込んだ値をホスト側のツールが読んで, 設定と送信ビット列を確認する.
+/************************************************************************************************/
+#ifndef RX_MOCK_IODEFINE_H_
+#define RX_MOCK_IODEFINE_H_
+
+/************************************ マクロ *************************************************/
+// 割込みベクタ番号
+#define VECT_CMT1_CMI1   29
+#define VECT_RSPI0_SPRI0 45
+#define VECT(x, y) VECT_##x##_##y
+
+// 割込み要求・許可・優先度, DTC起動, モジュールストップ. どれも書き込みを受けるだけ.
+#define IR(x, y)   (mock_ir[VECT(x, y)])
+#define IEN(x, y)  (mock_ien[VECT(x, y)])
+#define IPR(x, y)  (mock_ipr[VECT(x, y)])
+#define DTCE(x, y) (mock_dtce[VECT(x, y)])
+#define MSTP(x)    (mock_mstp_##x)
+/********************************************************************************************/
+
+
+/**************************************** 型定義 ********************************************/
+struct st_port {
+    union { unsigned char BYTE; struct { unsigned char B0:1, B1:1, B2:1, B3:1, B4:1, B5:1, B6:1, B7:1; } BIT; } PDR;
+    union { unsigned char BYTE; struct { unsigned char B0:1, B1:1, B2:1, B3:1, B4:1, B5:1, B6:1, B7:1; } BIT; } PODR;
+    union { unsigned char BYTE; struct { unsigned char B0:1, B1:1, B2:1, B3:1, B4:1, B5:1, B6:1, B7:1; } BIT; } PIDR;
+    union { unsigned char BYTE; struct { unsigned char B0:1, B1:1, B2:1, B3:1, B4:1, B5:1, B6:1, B7:1; } BIT; } PMR;
+};
+
+struct st_system {
+    union { unsigned short WORD; } PRCR;
+};
+
+struct st_mpc {
+    union { unsigned char BYTE; struct { unsigned char :6, PFSWE:1, B0WI:1; } BIT; } PWPR;
+    union { unsigned char BYTE; struct { unsigned char PSEL:5, :1, ISEL:1, ASEL:1; } BIT; } PC4PFS, PC5PFS, PC6PFS;
+};
+
+struct st_rspi {
+    union { unsigned char BYTE; struct { unsigned char SPMS:1, TXMD:1, MODFEN:1, MSTR:1, SPEIE:1, SPTIE:1, SPE:1, SPRIE:1; } BIT; } SPCR;
+    union { unsigned char BYTE; struct { unsigned char SSL0P:1, SSL1P:1, SSL2P:1, SSL3P:1, :4; } BIT; } SSLP;
+    union { unsigned char BYTE; struct { unsigned char SPLP:1, SPLP2:1, :2, MOIFV:1, MOIFE:1, :2; } BIT; } SPPCR;
+    union { unsigned char BYTE; struct { unsigned char OVRF:1, IDLNF:1, MODF:1, PERF:1, :4; } BIT; } SPSR;
+    union { unsigned long LONG; struct { unsigned short H; } WORD; } SPDR;
+    union { unsigned char BYTE; struct { unsigned char SPSLN:3, :5; } BIT; } SPSCR;
+    unsigned char SPBR;
+    union { unsigned char BYTE; struct { unsigned char SPFC:2, :2, SPRDTD:1, SPLW:1, :2; } BIT; } SPDCR;
+    union { unsigned char BYTE; struct { unsigned char SCKDL:3, :5; } BIT; } SPCKD;
+    union { unsigned char BYTE; struct { unsigned char SLNDL:3, :5; } BIT; } SSLND;
+    union { unsigned char BYTE; struct { unsigned char SPNDL:3, :5; } BIT; } SPND;
+    union { unsigned char BYTE; struct { unsigned char SPPE:1, SPOE:1, SPIIE:1, PTE:1, :4; } BIT; } SPCR2;
+    union { unsigned short WORD; struct { unsigned short CPHA:1, CPOL:1, BRDV:2, SSLA:3, SSLKP:1, SPB:4, LSBF:1, SPNDEN:1, SLNDEN:1, SCKDEN:1; } BIT; } SPCMD0;
+};
+
+struct st_dtc {
+    union { unsigned char BYTE; struct { unsigned char :4, RRS:1, :3; } BIT; } DTCCR;
+    void *DTCVBR;
+    union { unsigned char BYTE; struct { unsigned char SHORT:1, :7; } BIT; } DTCADMOD;
+    union { unsigned char BYTE; struct { unsigned char DTCST:1, :7; } BIT; } DTCST;
+};
+/****************************************************************************************/
+
+
+/*************************************** グローバル変数 ***************************************/
+struct st_port   PORT1, PORTC, PORTE;
+struct st_system SYSTEM;
+struct st_mpc    MPC;
+struct st_rspi   RSPI0;
+struct st_dtc    DTC;
+
+unsigned char mock_ir[256], mock_ien[256], mock_ipr[256], mock_dtce[256];
+unsigned char mock_mstp_RSPI0 = 1, mock_mstp_DTC = 1, mock_mstp_CMT1 = 1;
+/*************************************************************************************************/
+
+#endif /* RX_MOCK_IODEFINE_H_ */
@@ -0,0 +1,514 @@
+/*********************************************************************************************/
+//
+//  FILE        : tune_eval.c
+//  DATE        : 2025/11/25 Tue.
+//  DESCRIPTION : 評価関数の重み調整ツール(ホストPC用)
+//  CPU TYPE    : ホストPC
+//
+//  Author T.Ijiro
+//
+//  ビルド・実行 (othello/host で)
+//    gcc -O2 -I.. -o tune_eval tune_eval.c -lm
+//    ./tune_eval -g 2000 > games.txt          : 自己対戦の棋譜を2000局生成
+//    ./tune_eval games.txt > ../eval_weights.h : 棋譜から重みを調整して eval_weights.h を出力
+//
+//  オプション
+//    -g 局数 : 自己対戦の棋譜を生成して標準出力へ
+//    -s 値   : 自己対戦の乱数シード
+//    -n 回数 : 勾配法の反復回数
+//
+//  Texel方式. 棋譜の各局面の評価値をシグモイドで勝率に変換し,
+//  実際の勝敗(赤勝ち 1, 引き分け 0.5, 緑勝ち 0)との二乗誤差が最小になるように
+//  POSITION_WEIGHTS, MOBILITY_WEIGHT, STABLE_WEIGHT を勾配法で調整する.
+//  POS_WEIGHT は盤面スコアの倍率として固定する.
+//  POSITION_WEIGHTS は8通りの対称性を保つため, 対称な10種類のマスごとに1つの値を調整する.
+//
+//  棋譜フォーマット (テキスト, 1行1局)
+//    1手を2文字で表す. "xy" = brd[y][x] に置いた手(x, y は 0〜7), "--" = スキップ.
+//    赤から打ち始める. 空白は無視する. '#' で始まる行はコメント.
+/************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "othello_ai.h"
+
+/************************************ マクロ *************************************************/
+#define SQUARE_CLASSES 10   // 対称性でまとめたマスの種類
+#define PARAM_COUNT    (SQUARE_CLASSES + 2) // マスの種類 + MOBILITY_WEIGHT + STABLE_WEIGHT
+#define PARAM_MOBILITY SQUARE_CLASSES
+#define PARAM_STABLE   (SQUARE_CLASSES + 1)
+
+#define SKIP_PLIES     4    // 序盤の局面は学習に使わない
+#define LINE_MAX_LEN   1024 // 棋譜1行の最大長
+
+#define SELFPLAY_DEPTH       2  // 自己対戦の先読み
+#define SELFPLAY_RANDOM_PLY  6  // 自己対戦で最初にランダムに打つ手数
+#define SELFPLAY_RANDOM_RATE 10 // 自己対戦でランダムに打つ確率[%]
+
+#define DEFAULT_ITERATIONS 1000
+#define LEARNING_RATE      0.5
+/********************************************************************************************/
+
+
+/**************************************** 型定義 ********************************************/
+// 学習用の局面. 評価する側から見た特徴量.
+struct Sample{
+    signed char square[SQUARE_CLASSES]; // マスの種類ごとの (自分のコマ数 - 相手のコマ数)
+    signed char mobility;               // -(相手の配置可能数)
+    signed char stable;                 // 自分の確定石数 - 相手の確定石数
+    float       result;                 // 勝敗 (勝ち 1, 引き分け 0.5, 負け 0)
+};
+/****************************************************************************************/
+
+
+/************************************************** グローバル変数 **************************************************/
+static struct Sample *samples;
+static long           sample_count;
+static long           sample_capacity;
+/***************************************************************************************************************************/
+
+
+/************************************************** 関数定義 **************************************************/
+// マスの種類. 左上の三角形に畳み込んで 0〜9 の番号にする.
+//   0 1 2 3
+//     4 5 6
+//       7 8
+//         9
+int square_class(int x, int y)
+{
+    static const int CLASS_TABLE[4][4] =
+    {
+        {0, 1, 2, 3},
+        {1, 4, 5, 6},
+        {2, 5, 7, 8},
+        {3, 6, 8, 9}
+    };
+
+    if(x > MAT_WIDTH  / 2 - 1) x = MAT_WIDTH  - 1 - x;
+    if(y > MAT_HEIGHT / 2 - 1) y = MAT_HEIGHT - 1 - y;
+
+    return CLASS_TABLE[y][x];
+}
+
+enum stone_color opponent(enum stone_color sc)
+{
+    return (sc == stone_red) ? stone_green : stone_red;
+}
+
+// 盤面初期化
+void init_board(enum stone_color brd[][MAT_WIDTH])
+{
+    int x, y;
+
+    for(y = 0; y < MAT_HEIGHT; y++)
+    {
+        for(x = 0; x < MAT_WIDTH; x++)
+        {
+            delete(brd, x, y);
+        }
+    }
+
+    place(brd, 3, 3, stone_red);
+    place(brd, 4, 4, stone_red);
+    place(brd, 3, 4, stone_green);
+    place(brd, 4, 3, stone_green);
+}
+
+// 手を打つ
+void play(enum stone_color brd[][MAT_WIDTH], int x, int y, enum stone_color sc)
+{
+    unsigned char flag = make_flip_dir_flag(brd, x, y, sc);
+
+    place(brd, x, y, sc);
+    flip_stones(flag, brd, x, y, sc);
+}
+
+// sc 側から見た特徴量を作る
+void make_sample(enum stone_color brd[][MAT_WIDTH], enum stone_color sc, float result, struct Sample *s)
+{
+    int x, y;
+    enum stone_color opp = opponent(sc);
+
+    memset(s, 0, sizeof(*s));
+
+    for(y = 0; y < MAT_HEIGHT; y++)
+    {
+        for(x = 0; x < MAT_WIDTH; x++)
+        {
+            if(read_stone_at(brd, x, y) == sc)       s->square[square_class(x, y)]++;
+            else if(read_stone_at(brd, x, y) == opp) s->square[square_class(x, y)]--;
+        }
+    }
+
+    s->mobility = -count_placeable(brd, opp);
+    s->stable   = count_stable_stones(brd, sc) - count_stable_stones(brd, opp);
+    s->result   = result;
+}
+
+void add_sample(const struct Sample *s)
+{
+    if(sample_count == sample_capacity)
+    {
+        sample_capacity = sample_capacity ? sample_capacity * 2 : 4096;
+        samples = realloc(samples, sizeof(struct Sample) * sample_capacity);
+
+        if(!samples)
+        {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+
+    samples[sample_count++] = *s;
+}
+
+// 棋譜1行を再生して局面を登録. 登録した局面数を返す.
+int load_game(const char *line, int line_no)
+{
+    enum stone_color board[MAT_HEIGHT][MAT_WIDTH];
+    enum stone_color history[MAT_HEIGHT * MAT_WIDTH * 2][MAT_HEIGHT][MAT_WIDTH];
+    enum stone_color sc = stone_red;
+    int plies = 0;
+    int i, x, y, red, green;
+    float result;
+    struct Sample s;
+
+    init_board(board);
+
+    while(*line)
+    {
+        if(*line == ' ' || *line == '\t' || *line == '\r' || *line == '\n')
+        {
+            line++;
+            continue;
+        }
+
+        if(!line[1] || plies >= MAT_HEIGHT * MAT_WIDTH * 2)
+        {
+            fprintf(stderr, "line %d: broken record\n", line_no);
+            return 0;
+        }
+
+        if(line[0] != '-')
+        {
+            x = line[0] - '0';
+            y = line[1] - '0';
+
+            if(is_out_of_board(x, y) || !is_placeable(board, x, y, sc))
+            {
+                fprintf(stderr, "line %d: illegal move %c%c at ply %d\n", line_no, line[0], line[1], plies + 1);
+                return 0;
+            }
+
+            play(board, x, y, sc);
+        }
+
+        memcpy(history[plies], board, sizeof(board));
+        plies++;
+        sc = opponent(sc);
+        line += 2;
+    }
+
+    // 最終局面から勝敗を決める
+    red   = count_stones(board, stone_red);
+    green = count_stones(board, stone_green);
+    result = (red > green) ? 1.0f : (red < green) ? 0.0f : 0.5f;
+
+    // 赤から見た局面と緑から見た局面の両方を使う
+    for(i = SKIP_PLIES; i < plies; i++)
+    {
+        make_sample(history[i], stone_red, result, &s);
+        add_sample(&s);
+        make_sample(history[i], stone_green, 1.0f - result, &s);
+        add_sample(&s);
+    }
+
+    return (plies > SKIP_PLIES) ? (plies - SKIP_PLIES) * 2 : 0;
+}
+
+int load_file(const char *path)
+{
+    char line[LINE_MAX_LEN];
+    int line_no = 0;
+    int games = 0;
+    FILE *fp = fopen(path, "r");
+
+    if(!fp)
+    {
+        perror(path);
+        exit(1);
+    }
+
+    while(fgets(line, sizeof(line), fp))
+    {
+        line_no++;
+
+        if(line[0] == '#' || line[0] == '\n' || line[0] == '\r') continue;
+
+        if(load_game(line, line_no)) games++;
+    }
+
+    fclose(fp);
+
+    return games;
+}
+
+// パラメータから評価値を計算. evaluate_board と同じ式.
+double evaluate_sample(const struct Sample *s, const double *p)
+{
+    int k;
+    double position_score = 0.0;
+
+    for(k = 0; k < SQUARE_CLASSES; k++)
+    {
+        position_score += p[k] * s->square[k];
+    }
+
+    return position_score * POS_WEIGHT + p[PARAM_MOBILITY] * s->mobility + p[PARAM_STABLE] * s->stable;
+}
+
+double sigmoid(double e, double k)
+{
+    return 1.0 / (1.0 + exp(-k * e));
+}
+
+double mean_error(const double *p, double k)
+{
+    long i;
+    double d, sum = 0.0;
+
+    for(i = 0; i < sample_count; i++)
+    {
+        d = samples[i].result - sigmoid(evaluate_sample(&samples[i], p), k);
+        sum += d * d;
+    }
+
+    return sum / sample_count;
+}
+
+// 現在の重みで誤差が最小になるシグモイドの傾きを探す
+double fit_scale(const double *p)
+{
+    double k, best_k = 1e-3;
+    double e, best_e = mean_error(p, best_k);
+
+    for(k = 1e-5; k < 1e-1; k *= 1.05)
+    {
+        e = mean_error(p, k);
+
+        if(e < best_e)
+        {
+            best_e = e;
+            best_k = k;
+        }
+    }
+
+    return best_k;
+}
+
+// Adamで二乗誤差を最小化
+void tune(double *p, double k, int iterations)
+{
+    double grad[PARAM_COUNT], m[PARAM_COUNT], v[PARAM_COUNT];
+    double sig, g, b1t = 1.0, b2t = 1.0;
+    const double b1 = 0.9, b2 = 0.999;
+    long i;
+    int it, j;
+
+    memset(m, 0, sizeof(m));
+    memset(v, 0, sizeof(v));
+
+    for(it = 1; it <= iterations; it++)
+    {
+        memset(grad, 0, sizeof(grad));
+
+        for(i = 0; i < sample_count; i++)
+        {
+            const struct Sample *s = &samples[i];
+
+            sig = sigmoid(evaluate_sample(s, p), k);
+            g = -2.0 * (s->result - sig) * sig * (1.0 - sig) * k;
+
+            for(j = 0; j < SQUARE_CLASSES; j++)
+            {
+                grad[j] += g * s->square[j] * POS_WEIGHT;
+            }
+
+            grad[PARAM_MOBILITY] += g * s->mobility;
+            grad[PARAM_STABLE]   += g * s->stable;
+        }
+
+        b1t *= b1;
+        b2t *= b2;
+
+        for(j = 0; j < PARAM_COUNT; j++)
+        {
+            g = grad[j] / sample_count;
+            m[j] = b1 * m[j] + (1.0 - b1) * g;
+            v[j] = b2 * v[j] + (1.0 - b2) * g * g;
+            p[j] -= LEARNING_RATE * (m[j] / (1.0 - b1t)) / (sqrt(v[j] / (1.0 - b2t)) + 1e-12);
+        }
+
+        if(it % 500 == 0)
+        {
+            fprintf(stderr, "iteration %d: error %.6f\n", it, mean_error(p, k));
+        }
+    }
+}
+
+// eval_weights.h を出力
+void print_header(const double *p, int games, double error_before, double error_after)
+{
+    int x, y;
+
+    printf("/*\n");
+    printf(" *  eval_weights.h\n");
+    printf(" *\n");
+    printf(" *  評価関数の重み係数と盤面のスコア定義.\n");
+    printf(" *  host/tune_eval で棋譜から再生成できる. 手で変えるときは盤面の対称性(8通り)を保つこと.\n");
+    printf(" *  MAT_WIDTH, MAT_HEIGHT を定義してからインクルードする.\n");
+    printf(" *\n");
+    printf(" *  tune_eval で生成 : %d局, %ld局面, 誤差 %.6f -> %.6f\n", games, sample_count, error_before, error_after);
+    printf(" */\n");
+    printf("\n");
+    printf("#ifndef EVAL_WEIGHTS_H_\n");
+    printf("#define EVAL_WEIGHTS_H_\n");
+    printf("\n");
+    printf("// 評価関数の重み係数定義. どの要素をどれくらい重要視するか.\n");
+    printf("#define POS_WEIGHT      %-3d // 位置評価の重み係数\n", POS_WEIGHT);
+    printf("#define MOBILITY_WEIGHT %-3d // 配置可能数評価の重み係数\n", (int)lround(p[PARAM_MOBILITY]));
+    printf("#define STABLE_WEIGHT   %-3d // 確定石数（４つ角）評価の重み係数\n", (int)lround(p[PARAM_STABLE]));
+    printf("\n");
+    printf("// 盤面のスコア定義\n");
+    printf("static const int POSITION_WEIGHTS[MAT_HEIGHT][MAT_WIDTH] =\n");
+    printf("{\n");
+
+    for(y = 0; y < MAT_HEIGHT; y++)
+    {
+        printf("    {");
+
+        for(x = 0; x < MAT_WIDTH; x++)
+        {
+            printf("%3ld%s", lround(p[square_class(x, y)]), (x < MAT_WIDTH - 1) ? ", " : "");
+        }
+
+        printf("}%s\n", (y < MAT_HEIGHT - 1) ? "," : "");
+    }
+
+    printf("};\n");
+    printf("\n");
+    printf("#endif /* EVAL_WEIGHTS_H_ */\n");
+}
+
+// 自己対戦の棋譜を生成
+void self_play(int games)
+{
+    enum stone_color board[MAT_HEIGHT][MAT_WIDTH];
+    enum stone_color sc;
+    int g, i, ply, best_idx, passes;
+
+    for(g = 0; g < games; g++)
+    {
+        init_board(board);
+        sc = stone_red;
+        passes = 0;
+
+        for(ply = 0; passes < 2; ply++)
+        {
+            if(!count_placeable(board, sc))
+            {
+                printf("--");
+                passes++;
+                sc = opponent(sc);
+                continue;
+            }
+
+            passes = 0;
+
+            minimax_alphabeta(board, sc, SELFPLAY_DEPTH);
+
+            if(ply < SELFPLAY_RANDOM_PLY || rand() % 100 < SELFPLAY_RANDOM_RATE)
+            {
+                best_idx = rand() % ai_move_counts[0];
+            }
+            else
+            {
+                best_idx = 0;
+
+                for(i = 1; i < ai_move_counts[0]; i++)
+                {
+                    if(ai_moves[0][i].score > ai_moves[0][best_idx].score) best_idx = i;
+                }
+            }
+
+            play(board, ai_moves[0][best_idx].x, ai_moves[0][best_idx].y, sc);
+            printf("%d%d", ai_moves[0][best_idx].x, ai_moves[0][best_idx].y);
+            sc = opponent(sc);
+        }
+
+        printf("\n");
+    }
+}
+
+void usage(void)
+{
+    fprintf(stderr, "usage: tune_eval [-n iterations] log...\n");
+    fprintf(stderr, "       tune_eval -g games [-s seed]\n");
+    exit(1);
+}
+/*************************************************************************************************/
+
+
+/******************************************** メイン ***********************************************/
+int main(int argc, char *argv[])
+{
+    double params[PARAM_COUNT];
+    double k, error_before, error_after;
+    int iterations = DEFAULT_ITERATIONS;
+    int selfplay_games = 0;
+    int games = 0;
+    int i, x, y;
+
+    srand(1);
+
+    for(i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-g") == 0 && i + 1 < argc)      selfplay_games = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc) srand((unsigned)atoi(argv[++i]));
+        else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) iterations = atoi(argv[++i]);
+        else if(argv[i][0] == '-')                          usage();
+        else                                                games += load_file(argv[i]);
+    }
+
+    if(selfplay_games)
+    {
+        self_play(selfplay_games);
+        return 0;
+    }
+
+    if(!sample_count) usage();
+
+    // 現在の重みから始める
+    for(y = 0; y < MAT_HEIGHT; y++)
+    {
+        for(x = 0; x < MAT_WIDTH; x++)
+        {
+            params[square_class(x, y)] = POSITION_WEIGHTS[y][x];
+        }
+    }
+
+    params[PARAM_MOBILITY] = MOBILITY_WEIGHT;
+    params[PARAM_STABLE]   = STABLE_WEIGHT;
+
+    k = fit_scale(params);
+    error_before = mean_error(params, k);
+    fprintf(stderr, "%d games, %ld samples, scale %g, error %.6f\n", games, sample_count, k, error_before);
+
+    tune(params, k, iterations);
+
+    error_after = mean_error(params, k);
+    print_header(params, games, error_before, error_after);
+
+    return 0;
+}
@@ -9,11 +9,22 @@
 #define LCD_LIB4_H_
 
 #include "iodefine.h"
+#include "clock_config.h"
 
 #define LCD_E	PORTD.PODR.BIT.B3
 #define LCD_RS	PORTD.PODR.BIT.B0
 #define LCD_RW	PORTD.PODR.BIT.B1
 #define LCD_DB	PORTD.PODR.BYTE
+#define LCD_BF	PORTD.PIDR.BIT.B7	// busy flag (DB7) while LCD_RW = 1
+
+// Delay timer : CMT3 free-running at PCLKB/8 (clock_config.h)
+#define LCD_TIMER_COUNTS(us)	((unsigned long)(us) * (CLK_PCLKB_HZ / 100000UL) / 80)
+// Busy flag timeouts. When the busy flag does not clear in time (LCD_RW not wired),
+// the driver stops reading it and uses these as fixed delays.
+#define LCD_BUSY_TIMEOUT_US	50	// normal instruction (37us)
+#define LCD_CLEAR_TIMEOUT_US	2000	// clear (1.52ms)
+#define LCD_BUSY_TIMEOUT_TICKS	(LCD_LONG_WAIT_TICKS + 1)	// lcd_tick() retries
+// Define LCD_NO_BUSY_FLAG when LCD_RW is tied to GND : reading would write an instruction.
 
 //	LCD Mode
 #define CMDmode	(LCD_RS = 0)
@@ -27,11 +38,33 @@
 #define LCD_ENTSET	0x06
 #define	LCD_DISP_NCUR	0x0C
 
+// Buffer entry : b7-0 = data, b8 = RS, b9 = long instruction (clear),
+// b10 = 8-bit mode instruction (upper nibble only), b11 = send nothing, b15-12 = ms to wait after
+#define LCD_BUF_RS	0x0100
+#define LCD_BUF_LONG	0x0200
+#define LCD_BUF_NIBBLE	0x0400
+#define LCD_BUF_NOP	0x0800
+#define LCD_BUF_WAIT(ms)	((unsigned short)(ms) << 12)
+#define LCD_BUF_WAIT_MS(e)	((e) >> 12)
+#define LCD_POWER_ON_MS	15	// wait after power on (15ms, max 15)
+#define LCD_LONG_WAIT_TICKS	2	// lcd_tick()の周期(1ms)で数えた LCD_CLEAR の実行待ち
+
 //Prototype declaration of function
 void wait50us(unsigned int wait_time);
+void lcd_timer_init(void);
+void lcd_delay_us(unsigned long us);
+unsigned char lcd_read_busy(void);
+void lcd_wait_ready(unsigned long timeout_us);
+void lcd_nibble_done(unsigned short data);
+void lcd_drain(void);
 void flush_lcd(void);
+void lcd_shadow_reset(void);
 void init_LCD(void);
+void lcd_start_async(void);
+void lcd_tick(void);
+void lcd_enqueue(unsigned short data);
 void lcd_clear(void);
+void lcd_cmd(unsigned char c);
 void lcd_put(char c);
 void lcd_puts(char *str);
 void lcd_xy(unsigned char x, unsigned char y);
@@ -39,93 +72,283 @@ void lcd_dataout(unsigned long data);
 void set_pattern(void);
 
 //Groval variables
-#define BUFFER_SIZE 32
-static unsigned char buf[BUFFER_SIZE];
-static unsigned char wp, rp;
+// wp is written by the main loop, rp by lcd_tick() once lcd_start_async() is called.
+// init_LCD() only queues the initialization, so it is sent by lcd_tick() or lcd_drain().
+// A full buffer makes lcd_put() wait instead of overwriting unsent data.
+#define BUFFER_SIZE 128	// init_LCD() queues about 85 entries
+static unsigned short buf[BUFFER_SIZE];
+static volatile unsigned char wp, rp;
+static volatile unsigned char lcd_async;	// 1 : lcd_tick() sends the buffer
+static unsigned char lcd_nibble;	// 0 : upper nibble next, 1 : lower nibble next
+static unsigned char lcd_wait;	// ticks to wait after a long instruction or a LCD_BUF_WAIT entry
+static volatile unsigned char lcd_bf_ok;	// 1 : busy flag can be read
+static unsigned char lcd_busy_ticks;	// lcd_tick() calls the LCD has been busy
+
+// Shadow framebuffer. lcd_xy/lcd_put/lcd_clear write lcd_shadow, and flush_lcd() sends
+// only the characters that differ from lcd_glass (what is on the display).
+#define LCD_COLS	16
+#define LCD_ROWS	2
+#define LCD_ADDR_UNKNOWN	0xFF
+static unsigned char lcd_shadow[LCD_ROWS][LCD_COLS];
+static unsigned char lcd_glass[LCD_ROWS][LCD_COLS];
+static unsigned char lcd_cx, lcd_cy;	// write position in lcd_shadow
+static unsigned char lcd_addr;	// DDRAM address counter of the LCD
+
+void lcd_timer_init(void){
+	SYSTEM.PRCR.WORD = 0xA502;
+	MSTP(CMT3) = 0;
+	SYSTEM.PRCR.WORD = 0xA500;
+	CMT3.CMCR.WORD = 0x0080;	// PCLKB/8, no interrupt
+	CMT3.CMCOR = 0xFFFF;
+	CMT.CMSTR1.BIT.STR3 = 1;
+}
 
-#define loop_const	225
-//#define loop_const	4
+void lcd_delay_us(unsigned long us){
+	unsigned long counts = LCD_TIMER_COUNTS(us);
+	unsigned short start, now;
+
+	start = CMT3.CMCNT;
+	while(counts > 0){
+		now = CMT3.CMCNT;
+		if((unsigned short)(now - start) >= counts) break;
+		if((unsigned short)(now - start) >= 0x8000){	// keep within 16 bits
+			counts -= (unsigned short)(now - start);
+			start = now;
+		}
+	}
+}
 
 void wait50us(unsigned int wait_time){
-	volatile unsigned int loop1,loop2;
+	lcd_delay_us(50UL * wait_time);
+}
+
+// Reads the busy flag (4-bit mode : two reads, DB7 of the first is BF).
+unsigned char lcd_read_busy(void){
+	unsigned char bf;
+
+	PORTD.PDR.BYTE &= 0x0F;	// DB4-7 input
+	LCD_RS = 0;
+	LCD_RW = 1;
+
+	LCD_E = 1;
+	LCD_E = 1;	// data delay time
+	bf = LCD_BF;
+	LCD_E = 0;
+
+	LCD_E = 1;	// address counter, discarded
+	LCD_E = 1;
+	LCD_E = 0;
+
+	LCD_RW = 0;
+	PORTD.PDR.BYTE |= 0xF0;
+
+	return bf;
+}
+
+// Waits until the LCD is ready. Polls the busy flag, or waits timeout_us when it cannot be read.
+void lcd_wait_ready(unsigned long timeout_us){
+	unsigned short start = CMT3.CMCNT;
+
+	if(!lcd_bf_ok){
+		lcd_delay_us(timeout_us);
+		return;
+	}
 
-	for(loop1 = 0; loop1 < wait_time; loop1++){
-		for(loop2 = 0; loop2 < loop_const; loop2++);
+	while(lcd_read_busy()){
+		if((unsigned short)(CMT3.CMCNT - start) >= LCD_TIMER_COUNTS(timeout_us)){
+			lcd_bf_ok = 0;	// no busy flag : timed delays from now on
+			return;
+		}
 	}
 }
 
-void flush_lcd(void){
-	unsigned char data;
+// After an 8-bit mode instruction. The busy flag can be read once the interface is 4-bit.
+void lcd_nibble_done(unsigned short data){
+#ifndef LCD_NO_BUSY_FLAG
+	if((data & 0xF0) == (LCD_INIT4B << 4)) lcd_bf_ok = 1;
+#endif
+}
+
+// Sends the buffer synchronously. After lcd_start_async() the buffer is sent by lcd_tick(),
+// so this returns at once.
+void lcd_drain(void){
+	unsigned short data;
+
+	if(lcd_async) return;
 
 	while(wp != rp){
 		data = buf[rp];
 		rp++;
 		if(rp >= BUFFER_SIZE) rp = 0;
 
-		wait50us(1);
-		LCD_E = 1;
-		LCD_DB = (LCD_DB & 0x0F) | (data & 0xF0);
-		LCD_E = 0;
-		LCD_E = 0;
+		if(!(data & LCD_BUF_NOP)){
+			LCD_RS = (data & LCD_BUF_RS) ? 1 : 0;
+
+			LCD_E = 1;
+			LCD_DB = (LCD_DB & 0x0F) | (data & 0xF0);
+			LCD_E = 0;
+			LCD_E = 0;
+
+			if(data & LCD_BUF_NIBBLE){
+				lcd_nibble_done(data);
+			}else{
+				LCD_E = 1;
+				LCD_DB = (LCD_DB & 0x0F) | (data << 4);
+				LCD_E = 0;
+				LCD_E = 0;
+
+				lcd_wait_ready((data & LCD_BUF_LONG) ? LCD_CLEAR_TIMEOUT_US : LCD_BUSY_TIMEOUT_US);
+			}
+		}
+
+		if(LCD_BUF_WAIT_MS(data)) lcd_delay_us(1000UL * LCD_BUF_WAIT_MS(data));
+	}
+}
+
+// Queues the characters of lcd_shadow that differ from lcd_glass, with an address set
+// only where the LCD address counter is not already at the character.
+void flush_lcd(void){
+	unsigned char x, y, adr;
+
+	for(y = 0; y < LCD_ROWS; y++){
+		for(x = 0; x < LCD_COLS; x++){
+			if(lcd_shadow[y][x] == lcd_glass[y][x]) continue;
+
+			adr = x + (y ? 0x40 : 0x00);
+			if(adr != lcd_addr) lcd_enqueue(0x80 | adr);
+
+			lcd_enqueue(LCD_BUF_RS | lcd_shadow[y][x]);
+			lcd_glass[y][x] = lcd_shadow[y][x];
+			lcd_addr = adr + 1;
+		}
+	}
+
+	lcd_drain();
+}
+
+// Sets lcd_shadow and lcd_glass to a cleared display.
+void lcd_shadow_reset(void){
+	unsigned char x, y;
+
+	for(y = 0; y < LCD_ROWS; y++){
+		for(x = 0; x < LCD_COLS; x++){
+			lcd_shadow[y][x] = ' ';
+			lcd_glass[y][x] = ' ';
+		}
+	}
+
+	lcd_cx = lcd_cy = 0;
+	lcd_addr = 0x00;
+}
+
+// From now on lcd_tick() sends the buffer, including what is already queued.
+void lcd_start_async(void){
+	lcd_nibble = 0;
+	lcd_wait = 0;
+	lcd_busy_ticks = 0;
+	lcd_async = 1;
+}
+
+// Sends one nibble of the buffer. Call from a 1ms timer interrupt.
+void lcd_tick(void){
+	unsigned short data;
+
+	if(lcd_wait){
+		lcd_wait--;
+		return;
+	}
+
+	if(!lcd_async || wp == rp) return;
+
+	data = buf[rp];
+
+	// retry on the next tick while the previous instruction runs
+	if(!lcd_nibble && lcd_bf_ok && !(data & (LCD_BUF_NIBBLE | LCD_BUF_NOP))){
+		if(lcd_read_busy()){
+			if(++lcd_busy_ticks < LCD_BUSY_TIMEOUT_TICKS) return;
+			lcd_bf_ok = 0;	// no busy flag : the wait has already passed
+		}
+		lcd_busy_ticks = 0;
+	}
+
+	if(!(data & LCD_BUF_NOP)){
+		LCD_RS = (data & LCD_BUF_RS) ? 1 : 0;
 
 		LCD_E = 1;
-		LCD_DB = (LCD_DB & 0x0F) | (data << 4);
+		if(!lcd_nibble){
+			LCD_DB = (LCD_DB & 0x0F) | (data & 0xF0);
+		}else{
+			LCD_DB = (LCD_DB & 0x0F) | (data << 4);
+		}
 		LCD_E = 0;
 		LCD_E = 0;
+
+		if(data & LCD_BUF_NIBBLE){
+			lcd_nibble_done(data);
+		}else if(!lcd_nibble){
+			lcd_nibble = 1;
+			return;
+		}
+	}
+
+	lcd_nibble = 0;
+	if((data & LCD_BUF_LONG) && !lcd_bf_ok) lcd_wait = LCD_LONG_WAIT_TICKS;
+	if(LCD_BUF_WAIT_MS(data)) lcd_wait = LCD_BUF_WAIT_MS(data);
+
+	if(rp + 1 >= BUFFER_SIZE){
+		rp = 0;
+	}else{
+		rp++;
 	}
 }
 
+// Adds an entry to the buffer. Waits while the buffer is full.
+void lcd_enqueue(unsigned short data){
+	unsigned char next = wp + 1;
+
+	if(next >= BUFFER_SIZE) next = 0;
+
+	while(next == rp){
+		lcd_drain();	// async : lcd_tick() frees a slot
+	}
+
+	buf[wp] = data;
+	wp = next;
+}
+
+// Power-on initialization by instruction. Only queues the sequence with its delays and returns
+// at once : lcd_start_async() lets lcd_tick() send it while the other peripherals are set up,
+// or lcd_drain() sends it here. The busy flag cannot be read until the interface is in 4-bit mode,
+// so the 8-bit mode steps wait the minimum datasheet delays (rounded up to 1ms).
 void init_LCD(void){
-	wait50us(1000);
+	lcd_timer_init();
 	PORTD.PDR.BYTE = 0xff;
 	PORTD.PODR.BYTE &= 0x00;
 
 	wp = rp = 0;
+	lcd_async = 0;
+	lcd_bf_ok = 0;
+	lcd_nibble = 0;
+	lcd_wait = 0;
 	CMDmode;
 	LCD_E = 0;
 
-	LCD_E = 1;
-	LCD_DB = (LCD_DB & 0x0F) | (LCD_INIT8B << 4);
-	LCD_E = 0;
-
-	wait50us(200);
-	LCD_E = 1;
-	LCD_DB = (LCD_DB & 0x0F) | (LCD_INIT8B << 4);
-	LCD_E = 0;
-
-	wait50us(40);
-	LCD_E = 1;
-	LCD_DB = (LCD_DB & 0x0F) | (LCD_INIT8B << 4);
-	LCD_E = 0;
-
-	wait50us(40);
-	LCD_E = 1;
-	LCD_DB = (LCD_DB & 0x0F) | (LCD_INIT4B << 4);
-	LCD_E = 0;
-
-	wait50us(40);
-	lcd_put(LCD_FCSET4B);
-	flush_lcd();
-
-	wait50us(40);
-	lcd_put(LCD_DISP_OFF);
-	flush_lcd();
-
-	wait50us(40);
-	lcd_put(LCD_CLEAR);
-	flush_lcd();
+	lcd_enqueue(LCD_BUF_NOP | LCD_BUF_WAIT(LCD_POWER_ON_MS));
+	lcd_enqueue(LCD_BUF_NIBBLE | LCD_BUF_WAIT(5) | (LCD_INIT8B << 4));	// 4.1ms
+	lcd_enqueue(LCD_BUF_NIBBLE | LCD_BUF_WAIT(1) | (LCD_INIT8B << 4));	// 100us
+	lcd_enqueue(LCD_BUF_NIBBLE | LCD_BUF_WAIT(1) | (LCD_INIT8B << 4));
+	lcd_enqueue(LCD_BUF_NIBBLE | LCD_BUF_WAIT(1) | (LCD_INIT4B << 4));
 
-	wait50us(40);
-	lcd_put(LCD_ENTSET);
-	flush_lcd();
-
-	wait50us(40);
-	lcd_put(LCD_DISP_NCUR);
-	flush_lcd();
+	lcd_cmd(LCD_FCSET4B);
+	lcd_cmd(LCD_DISP_OFF);
+	lcd_enqueue(LCD_BUF_LONG | LCD_CLEAR);
+	lcd_cmd(LCD_ENTSET);
+	lcd_cmd(LCD_DISP_NCUR);
 
 	set_pattern();
 
-	lcd_clear();
+	lcd_enqueue(LCD_BUF_LONG | LCD_CLEAR);
+	lcd_shadow_reset();
 }
 
 //CG-RAMへのキャラクタパターンの書き込み
@@ -145,26 +368,31 @@ const char ptn[9][8] = {
 void set_pattern(void){
 	unsigned char nc,pr;
 
-	CMDmode;
-	lcd_put(cgram_start_address);
-	flush_lcd();
+	lcd_cmd(cgram_start_address);
 
-	DATmode;
 	for(nc = 0; nc < 9; nc++){
 		for(pr = 0; pr < 8; pr++){
-			lcd_put(ptn[nc][pr]);
+			lcd_enqueue(LCD_BUF_RS | (unsigned char)ptn[nc][pr]);
 		}
-		flush_lcd();
 	}
+	lcd_addr = LCD_ADDR_UNKNOWN;
 }
 
+// Clears lcd_shadow. Only the characters that were not blank are rewritten by flush_lcd().
 void lcd_clear(void){
-	flush_lcd();
-	CMDmode;
-	lcd_put(LCD_CLEAR);
-	flush_lcd();
-	wait50us(40);
-	DATmode;
+	unsigned char x, y;
+
+	for(y = 0; y < LCD_ROWS; y++){
+		for(x = 0; x < LCD_COLS; x++){
+			lcd_shadow[y][x] = ' ';
+		}
+	}
+
+	lcd_cx = lcd_cy = 0;
+}
+
+void lcd_cmd(unsigned char c){
+	lcd_enqueue(c);
 }
 
 void lcd_put(char c){
@@ -176,9 +404,8 @@ void lcd_put(char c){
 		case 'q': c = 0x04; break;
 		case 'y': c = 0x05; break;
 	}
-	buf[wp] = c;
-	wp++;
-	if(wp >= BUFFER_SIZE) wp = 0;
+	if(lcd_cx < LCD_COLS) lcd_shadow[lcd_cy][lcd_cx] = c;
+	lcd_cx++;
 }
 
 void lcd_puts(char *str){
@@ -191,16 +418,10 @@ void lcd_puts(char *str){
 }
 
 void lcd_xy(unsigned char x, unsigned char y){
-	char adr;
-	flush_lcd();
-	CMDmode;
 	x--;y--;
 	if(x > 0x0f) x = 0x00;
-	if(y == 0x01) y = 0x40;
-	adr = (x + y) | 0x80;
-	lcd_put(adr);
-	flush_lcd();
-	DATmode;
+	lcd_cx = x;
+	lcd_cy = (y == 0x01) ? 1 : 0;
 }
 
 void lcd_dataout(unsigned long data){
@@ -0,0 +1,237 @@
+/*********************************************************************************************/
+//
+//  FILE        : matrix_out.h
+//  DATE        : 2025/11/25 Tue.
+//  DESCRIPTION : マトリックスLED(74HC595 2段)の列出力ドライバ
+//  CPU TYPE    : RX Family
+//
+//  Author T.Ijiro
+//
+//  出力方法は2通り. MATRIX_OUT_RSPI を定義するとハードウェア転送になる.
+//
+//  ・ソフトウェア (既定)
+//    col_out で16ビットをGPIOから1ビットずつ送り, ラッチしてから COL_EN を切り替える.
+//    SER = P15, SRCLK = P16, RCLK = P17
+//
+//  ・RSPI0 + DTC (MATRIX_OUT_RSPI)
+//    CMT1 CMI1 で DTC が matrix_tx_buf の1列分を RSPI0.SPDR に書き, RSPI0 が16ビットを送る.
+//    SSLA0 の立ち上がり(転送終了)で74HC595がラッチする. 転送完了(SPRI0)の割込みで
+//    matrix_rspi_col_done を呼び, COL_EN の切り替えと次の列のデータの準備だけを行う.
+//    配線を SER = PC6(MOSIA), SRCLK = PC5(RSPCKA), RCLK = PC4(SSLA0) に変更すること.
+//    DTCベクタテーブル matrix_dtc_vect は 0x400 境界に置く必要があるので,
+//    リンカのセクション設定で BDTC_VECT を 0x400 境界のアドレスに配置する.
+//
+//  送信順 : rg_data のビット0から順に送る. ビット y + 8 = 赤, ビット y = 緑.
+//           1 のビットは点灯(カソード側吸い込み)なので, 端子には反転して出す.
+//  ホストPCでのビット順の確認は host/check_matrix_out.c を参照.
+/************************************************************************************************/
+#ifndef MATRIX_OUT_H_
+#define MATRIX_OUT_H_
+
+#include <stdint.h>
+#include "iodefine.h"
+
+/************************************ マクロ *************************************************/
+#define MATRIX_COLS 8  // 列数
+#define MATRIX_BITS 16 // 1列のビット数(赤8 + 緑8)
+
+// 74HC595シフトレジスタのシリアルデータ送信コマンド. ホストPCのモックでは置き換える.
+#ifndef SERIAL_SINK
+#define SERIAL_SINK    do { PORT1.PODR.BIT.B5 = 0; } while(0)                        // 吸い込み
+#define SERIAL_SOURCE  do { PORT1.PODR.BIT.B5 = 1; } while(0)                        // 吐き出し
+#define SEND_LATCH_CLK do { PORT1.PODR.BIT.B6 = 1; PORT1.PODR.BIT.B6 = 0; } while(0) // ラッチ
+#define LATCH_OUT      do { PORT1.PODR.BIT.B7 = 1; PORT1.PODR.BIT.B7 = 0; } while(0) // ラッチ出力
+#endif
+
+// マトリックスLED
+#ifndef COL_EN
+#define COL_EN PORTE.PODR.BYTE  // 点灯列許可ビット選択
+#endif
+
+// RSPI0 のビットレート. PCLKB 25MHz / (2 * (SPBR + 1)) = 6.25MHz, 1列 約2.6us.
+#define MATRIX_RSPI_SPBR 1
+
+// RSPI0 の端子機能選択 (MOSIA, RSPCKA, SSLA0)
+#define MATRIX_RSPI_PSEL 0x0D
+
+// DTC 転送モード (MRA, MRB)
+#define DTC_MRA_MD_REPEAT  0x40 // リピート転送
+#define DTC_MRA_SZ_WORD    0x10 // 16ビット転送
+#define DTC_MRA_SM_INC     0x08 // 転送元アドレス加算
+#define DTC_MRB_DTS_SRC    0x10 // 転送元をリピート領域にする
+#define DTC_MRB_DM_FIXED   0x00 // 転送先アドレス固定
+/********************************************************************************************/
+
+
+/**************************************** 型定義 ********************************************/
+// DTC 転送情報 (フルアドレスモード)
+struct DtcInfo{
+    uint32_t mode;   // b31-24 MRA, b23-16 MRB
+    uint32_t sar;    // 転送元アドレス
+    uint32_t dar;    // 転送先アドレス
+    uint32_t count;  // b31-16 CRA, b15-0 CRB
+};
+/****************************************************************************************/
+
+
+/*************************************** グローバル変数 ***************************************/
+#ifdef MATRIX_OUT_RSPI
+static volatile uint16_t      matrix_tx_buf[MATRIX_COLS]; // DTC の転送元. 端子に出す値(反転済み).
+static volatile unsigned char matrix_col;                 // 次に転送が終わる列
+static struct DtcInfo         matrix_dtc_info;            // CMT1 CMI1 の転送情報
+
+#ifdef __RX
+#pragma section B DTC_VECT
+#endif
+static uint32_t matrix_dtc_vect[256];                     // DTCベクタテーブル. 0x400 境界に置く.
+#ifdef __RX
+#pragma section
+#endif
+#endif
+/*************************************************************************************************/
+
+
+/************************************************** 関数定義 **************************************************/
+// 赤緑データを端子に出す16ビットの値に変換する. 点灯は吸い込み(0)なので反転する.
+uint16_t matrix_spi_word(unsigned int rg_data)
+{
+    return (uint16_t)(~rg_data & 0xFFFF);
+}
+
+// 指定した列の赤緑データをマトリックスLEDに出力 (ソフトウェア)
+void col_out(int col, unsigned int rg_data)
+{
+	int i;
+
+    for(i = 0; i < MATRIX_BITS; i++)
+	{
+		if(rg_data & (1 << i))
+		{
+			SERIAL_SINK;    // 点灯(カソード側吸い込み)
+		}
+		else
+		{
+			SERIAL_SOURCE;  // 消灯(カソード側吐き出し)
+		}
+
+		SEND_LATCH_CLK;     // ラッチ
+	}
+
+	COL_EN = 0;             // 全消灯
+
+	LATCH_OUT;              // ラッチ出力
+
+	COL_EN = 1 << col;      // 点灯列指定
+}
+
+#ifdef MATRIX_OUT_RSPI
+// RSPI0 をマスタ, 16ビット, LSBファーストで初期化
+void init_matrix_rspi(void)
+{
+    SYSTEM.PRCR.WORD = 0x0A502;
+    MSTP(RSPI0) = 0;
+    SYSTEM.PRCR.WORD = 0x0A500;
+
+    // PC4 = SSLA0, PC5 = RSPCKA, PC6 = MOSIA
+    MPC.PWPR.BIT.B0WI  = 0;
+    MPC.PWPR.BIT.PFSWE = 1;
+    MPC.PC4PFS.BIT.PSEL = MATRIX_RSPI_PSEL;
+    MPC.PC5PFS.BIT.PSEL = MATRIX_RSPI_PSEL;
+    MPC.PC6PFS.BIT.PSEL = MATRIX_RSPI_PSEL;
+    MPC.PWPR.BIT.PFSWE = 0;
+    MPC.PWPR.BIT.B0WI  = 1;
+    PORTC.PMR.BIT.B4 = 1;
+    PORTC.PMR.BIT.B5 = 1;
+    PORTC.PMR.BIT.B6 = 1;
+
+    RSPI0.SPCR.BYTE   = 0x00;
+    RSPI0.SSLP.BYTE   = 0x00;  // SSL0 は負論理. ネゲートの立ち上がりでラッチ.
+    RSPI0.SPPCR.BYTE  = 0x00;
+    RSPI0.SPBR        = MATRIX_RSPI_SPBR;
+    RSPI0.SPDCR.BYTE  = 0x00;  // SPDR はワードアクセス, フレーム1つ
+    RSPI0.SPCKD.BYTE  = 0x00;
+    RSPI0.SSLND.BYTE  = 0x00;
+    RSPI0.SPND.BYTE   = 0x00;
+    RSPI0.SPSCR.BYTE  = 0x00;
+
+    RSPI0.SPCMD0.BIT.CPHA = 0; // 74HC595 は SRCLK の立ち上がりで取り込む
+    RSPI0.SPCMD0.BIT.CPOL = 0;
+    RSPI0.SPCMD0.BIT.BRDV = 0;
+    RSPI0.SPCMD0.BIT.SSLA = 0; // SSL0
+    RSPI0.SPCMD0.BIT.SSLKP = 0;
+    RSPI0.SPCMD0.BIT.SPB  = 0xF; // 16ビット
+    RSPI0.SPCMD0.BIT.LSBF = 1;   // ビット0から送る
+
+    // 他の割込みと同じ優先度1にして入れ子を作らない(othello.c の isr_stat, input_push はそれを前提にする).
+    // 列の転送は DTC が CMT1 から起こすので, CMT0 などの処理中に SPRI0 が待たされても
+    // 前の列の点灯がその分延びるだけ(数十us, 列の周期は SCAN_COL_PERIOD_US).
+    IPR(RSPI0, SPRI0) = 1;
+    IEN(RSPI0, SPRI0) = 1;
+
+    // 全二重で動かし, 受信完了を転送終了の通知に使う
+    RSPI0.SPCR.BIT.MSTR  = 1;
+    RSPI0.SPCR.BIT.TXMD  = 0;
+    RSPI0.SPCR.BIT.SPRIE = 1;
+    RSPI0.SPCR.BIT.SPE   = 1;
+}
+
+// CMT1 CMI1 で matrix_tx_buf を1列ずつ RSPI0.SPDR に書く DTC を設定
+void init_matrix_dtc(void)
+{
+    int x;
+
+    for(x = 0; x < MATRIX_COLS; x++)
+    {
+        matrix_tx_buf[x] = matrix_spi_word(0); // 全消灯
+    }
+
+    matrix_col = 0;
+
+    SYSTEM.PRCR.WORD = 0x0A502;
+    MSTP(DTC) = 0;
+    SYSTEM.PRCR.WORD = 0x0A500;
+
+    matrix_dtc_info.mode  = ((uint32_t)(DTC_MRA_MD_REPEAT | DTC_MRA_SZ_WORD | DTC_MRA_SM_INC) << 24)
+                          | ((uint32_t)(DTC_MRB_DTS_SRC | DTC_MRB_DM_FIXED) << 16);
+    matrix_dtc_info.sar   = (uint32_t)(uintptr_t)matrix_tx_buf;
+    matrix_dtc_info.dar   = (uint32_t)(uintptr_t)&RSPI0.SPDR;
+    matrix_dtc_info.count = ((uint32_t)MATRIX_COLS << 24) | ((uint32_t)MATRIX_COLS << 16); // CRAH = CRAL = 8
+
+    matrix_dtc_vect[VECT(CMT1, CMI1)] = (uint32_t)(uintptr_t)&matrix_dtc_info;
+
+    DTC.DTCVBR = (void *)matrix_dtc_vect;
+    DTC.DTCADMOD.BIT.SHORT = 0;
+    DTC.DTCCR.BIT.RRS = 0;
+    DTCE(CMT1, CMI1) = 1;  // CMT1 CMI1 はCPUに割り込まず DTC を起動する (リピート転送は終わらない)
+    DTC.DTCST.BIT.DTCST = 1;
+}
+
+// RSPI0 SPRI0 (1列の転送完了) から呼ぶ. SSLA0 のネゲートでラッチされるのを待って列を切り替える.
+// 戻り値 : 点灯させた列
+int matrix_rspi_col_done(void)
+{
+    int col = matrix_col;
+
+    (void)RSPI0.SPDR.WORD.H; // 受信データは捨てる
+
+    COL_EN = 0;              // 全消灯
+
+    while(RSPI0.SPSR.BIT.IDLNF)
+        ;                    // ラッチ出力待ち
+
+    COL_EN = 1 << col;       // 点灯列指定
+
+    matrix_col = (col + 1) % MATRIX_COLS;
+
+    return col;
+}
+
+// 次のフレームで送る列の赤緑データを DTC の転送元に書く
+void matrix_rspi_set_col(int col, unsigned int rg_data)
+{
+    matrix_tx_buf[col] = matrix_spi_word(rg_data);
+}
+#endif
+/*************************************************************************************************/
+
+#endif /* MATRIX_OUT_H_ */
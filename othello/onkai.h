@@ -10,89 +10,136 @@
 #ifndef ONKAI_H_
 #define ONKAI_H_
 
+#include "clock_config.h"
+
+// MTU0 count clock : PCLKB (clock_config.h) divided by TPSC, which init_BUZZER also writes.
+#define ONKAI_PCLK_HZ	(CLK_PCLKB_HZ * 1ULL)
+#ifndef ONKAI_MTU_TPSC
+#define ONKAI_MTU_TPSC	1	// 0 : PCLK/1, 1 : PCLK/4, 2 : PCLK/16, 3 : PCLK/64
+#endif
+#define ONKAI_CLOCK_HZ	(ONKAI_PCLK_HZ >> (2 * ONKAI_MTU_TPSC))
+
+// Pitch of A in octave 1 (A4) in micro hertz
+#ifndef ONKAI_A4_UHZ
+#define ONKAI_A4_UHZ	440000000ULL
+#endif
+
+// Equal temperament : 2^((n - 9) / 12) * 10^9 for n = 0 (DO) .. 11 (SI)
+#define ONKAI_RATIO_0	594603558ULL
+#define ONKAI_RATIO_1	629960525ULL
+#define ONKAI_RATIO_2	667419927ULL
+#define ONKAI_RATIO_3	707106781ULL
+#define ONKAI_RATIO_4	749153538ULL
+#define ONKAI_RATIO_5	793700526ULL
+#define ONKAI_RATIO_6	840896415ULL
+#define ONKAI_RATIO_7	890898718ULL
+#define ONKAI_RATIO_8	943874313ULL
+#define ONKAI_RATIO_9	1000000000ULL
+#define ONKAI_RATIO_10	1059463094ULL
+#define ONKAI_RATIO_11	1122462048ULL
+
+// Pitch of note n in octave 1 [uHz]
+#define ONKAI_UHZ(n)	((ONKAI_A4_UHZ * ONKAI_RATIO_##n + 500000000ULL) / 1000000000ULL)
+
+// Compare value for note n in octave oct. The counter clears on TGRA, so the period is
+// TGRA + 1 counts. Each note is rounded from the exact pitch, octaves included.
+#define ONKAI_DIV(num, den)	(((num) + (den) / 2) / (den))
+#define ONKAI_COUNTS(n, oct)	(((oct) <= 1 \
+	? ONKAI_DIV((ONKAI_CLOCK_HZ * 1000000ULL) << ((oct) <= 1 ? 1 - (oct) : 0), ONKAI_UHZ(n)) \
+	: ONKAI_DIV(ONKAI_CLOCK_HZ * 1000000ULL, ONKAI_UHZ(n) << ((oct) > 1 ? (oct) - 1 : 0))) - 1)
+#define ONKAI_NOTE(n, oct)	((unsigned int)ONKAI_COUNTS(n, oct))
+
+// TGRA is 16 bits : the lowest note must fit, the highest must still be a square wave
+#if ONKAI_COUNTS(0, 0) > 65535
+#error "ONKAI_PCLK_HZ / ONKAI_MTU_TPSC is too fast for octave 0. Raise ONKAI_MTU_TPSC."
+#endif
+#if ONKAI_COUNTS(11, 5) < 16
+#error "ONKAI_PCLK_HZ / ONKAI_MTU_TPSC is too slow for octave 5. Lower ONKAI_MTU_TPSC."
+#endif
+
 // --- Octave 0 ---
-#define DO0  (23889 << 1)
-#define DOS0 (22549 << 1)
-#define RE0  (21283 << 1)
-#define RES0 (20089 << 1)
-#define MI0  (18961 << 1)
-#define FA0  (17897 << 1)
-#define FAS0 (16892 << 1)
-#define SO0  (15944 << 1)
-#define SOS0 (15049 << 1)
-#define RA0  (14205 << 1)
-#define RAS0 (13407 << 1)
-#define SI0  (12655 << 1)
+#define DO0  ONKAI_NOTE(0, 0)
+#define DOS0 ONKAI_NOTE(1, 0)
+#define RE0  ONKAI_NOTE(2, 0)
+#define RES0 ONKAI_NOTE(3, 0)
+#define MI0  ONKAI_NOTE(4, 0)
+#define FA0  ONKAI_NOTE(5, 0)
+#define FAS0 ONKAI_NOTE(6, 0)
+#define SO0  ONKAI_NOTE(7, 0)
+#define SOS0 ONKAI_NOTE(8, 0)
+#define RA0  ONKAI_NOTE(9, 0)
+#define RAS0 ONKAI_NOTE(10, 0)
+#define SI0  ONKAI_NOTE(11, 0)
 
 // --- Octave 1 ---
-#define DO1  23889
-#define DOS1 22549
-#define RE1  21283
-#define RES1 20089
-#define MI1  18961
-#define FA1  17897
-#define FAS1 16892
-#define SO1  15944
-#define SOS1 15049
-#define RA1  14205
-#define RAS1 13407
-#define SI1  12655
+#define DO1  ONKAI_NOTE(0, 1)
+#define DOS1 ONKAI_NOTE(1, 1)
+#define RE1  ONKAI_NOTE(2, 1)
+#define RES1 ONKAI_NOTE(3, 1)
+#define MI1  ONKAI_NOTE(4, 1)
+#define FA1  ONKAI_NOTE(5, 1)
+#define FAS1 ONKAI_NOTE(6, 1)
+#define SO1  ONKAI_NOTE(7, 1)
+#define SOS1 ONKAI_NOTE(8, 1)
+#define RA1  ONKAI_NOTE(9, 1)
+#define RAS1 ONKAI_NOTE(10, 1)
+#define SI1  ONKAI_NOTE(11, 1)
 
 // --- Octave 2 ---
-#define DO2  (DO1  >> 1)
-#define DOS2 (DOS1 >> 1)
-#define RE2  (RE1  >> 1)
-#define RES2 (RES1 >> 1)
-#define MI2  (MI1  >> 1)
-#define FA2  (FA1  >> 1)
-#define FAS2 (FAS1 >> 1)
-#define SO2  (SO1  >> 1)
-#define SOS2 (SOS1 >> 1)
-#define RA2  (RA1  >> 1)
-#define RAS2 (RAS1 >> 1)
-#define SI2  (SI1  >> 1)
+#define DO2  ONKAI_NOTE(0, 2)
+#define DOS2 ONKAI_NOTE(1, 2)
+#define RE2  ONKAI_NOTE(2, 2)
+#define RES2 ONKAI_NOTE(3, 2)
+#define MI2  ONKAI_NOTE(4, 2)
+#define FA2  ONKAI_NOTE(5, 2)
+#define FAS2 ONKAI_NOTE(6, 2)
+#define SO2  ONKAI_NOTE(7, 2)
+#define SOS2 ONKAI_NOTE(8, 2)
+#define RA2  ONKAI_NOTE(9, 2)
+#define RAS2 ONKAI_NOTE(10, 2)
+#define SI2  ONKAI_NOTE(11, 2)
 
 // --- Octave 3 ---
-#define DO3  (DO1  >> 2)
-#define DOS3 (DOS1 >> 2)
-#define RE3  (RE1  >> 2)
-#define RES3 (RES1 >> 2)
-#define MI3  (MI1  >> 2)
-#define FA3  (FA1  >> 2)
-#define FAS3 (FAS1 >> 2)
-#define SO3  (SO1  >> 2)
-#define SOS3 (SOS1 >> 2)
-#define RA3  (RA1  >> 2)
-#define RAS3 (RAS1 >> 2)
-#define SI3  (SI1  >> 2)
+#define DO3  ONKAI_NOTE(0, 3)
+#define DOS3 ONKAI_NOTE(1, 3)
+#define RE3  ONKAI_NOTE(2, 3)
+#define RES3 ONKAI_NOTE(3, 3)
+#define MI3  ONKAI_NOTE(4, 3)
+#define FA3  ONKAI_NOTE(5, 3)
+#define FAS3 ONKAI_NOTE(6, 3)
+#define SO3  ONKAI_NOTE(7, 3)
+#define SOS3 ONKAI_NOTE(8, 3)
+#define RA3  ONKAI_NOTE(9, 3)
+#define RAS3 ONKAI_NOTE(10, 3)
+#define SI3  ONKAI_NOTE(11, 3)
 
 // --- Octave 4 ---
-#define DO4  (DO1  >> 3)
-#define DOS4 (DOS1 >> 3)
-#define RE4  (RE1  >> 3)
-#define RES4 (RES1 >> 3)
-#define MI4  (MI1  >> 3)
-#define FA4  (FA1  >> 3)
-#define FAS4 (FAS1 >> 3)
-#define SO4  (SO1  >> 3)
-#define SOS4 (SOS1 >> 3)
-#define RA4  (RA1  >> 3)
-#define RAS4 (RAS1 >> 3)
-#define SI4  (SI1  >> 3)
+#define DO4  ONKAI_NOTE(0, 4)
+#define DOS4 ONKAI_NOTE(1, 4)
+#define RE4  ONKAI_NOTE(2, 4)
+#define RES4 ONKAI_NOTE(3, 4)
+#define MI4  ONKAI_NOTE(4, 4)
+#define FA4  ONKAI_NOTE(5, 4)
+#define FAS4 ONKAI_NOTE(6, 4)
+#define SO4  ONKAI_NOTE(7, 4)
+#define SOS4 ONKAI_NOTE(8, 4)
+#define RA4  ONKAI_NOTE(9, 4)
+#define RAS4 ONKAI_NOTE(10, 4)
+#define SI4  ONKAI_NOTE(11, 4)
 
 // --- Octave 5 ---
-#define DO5  (DO1  >> 4)
-#define DOS5 (DOS1 >> 4)
-#define RE5  (RE1  >> 4)
-#define RES5 (RES1 >> 4)
-#define MI5  (MI1  >> 4)
-#define FA5  (FA1  >> 4)
-#define FAS5 (FAS1 >> 4)
-#define SO5  (SO1  >> 4)
-#define SOS5 (SOS1 >> 4)
-#define RA5  (RA1  >> 4)
-#define RAS5 (RAS1 >> 4)
-#define SI5  (SI1  >> 4)
+#define DO5  ONKAI_NOTE(0, 5)
+#define DOS5 ONKAI_NOTE(1, 5)
+#define RE5  ONKAI_NOTE(2, 5)
+#define RES5 ONKAI_NOTE(3, 5)
+#define MI5  ONKAI_NOTE(4, 5)
+#define FA5  ONKAI_NOTE(5, 5)
+#define FAS5 ONKAI_NOTE(6, 5)
+#define SO5  ONKAI_NOTE(7, 5)
+#define SOS5 ONKAI_NOTE(8, 5)
+#define RA5  ONKAI_NOTE(9, 5)
+#define RAS5 ONKAI_NOTE(10, 5)
+#define SI5  ONKAI_NOTE(11, 5)
 
 #define KU 1
 
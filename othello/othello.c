@@ -9,21 +9,63 @@
 //
 //  ビルド
 //  ・以下の割り込み関数をintprg.c内でコメントアウトする
-//    Excep_CMT0_CMI0, Excep_CMT1_CMI1, Excep_CMT2_CMI2, Excep_ICU_IRQ0, Excep_ICU_IRQ1
+//    Excep_CMT0_CMI0, Excep_CMT1_CMI1, Excep_ICU_IRQ0, Excep_ICU_IRQ1, Excep_SCI1_TXI1
+//    (MATRIX_OUT_RSPI を定義したときは Excep_RSPI0_SPRI0 も. 配線の変更は matrix_out.h を参照)
 //
 //  ・stacksct.h のsuを0xFFF8に変更する
+//    STACK_CHECK を定義すると起動時にスタック(SU, SI)を塗り, 's' を受信すると最大使用量とAI用バッファの大きさを送る.
+//    AI用バッファの大きさの AI_DEPTH ごとの表は host/bench_suite -m で出す.
+//
+//  ・盤面ロジックとAI探索は othello_ai.h にある. ホストPC用ツールは host/ を参照.
+//
+//  ・マトリックスLEDの列周期と点灯時間は SCAN_COL_PERIOD_US, SCAN_ON_TIME_PCT で変える.
+//    明るさの段階は BCM_PLANES で変える(既定の 1 は点灯/消灯のみ. 置ける場所などの暗い表示は 2 以上で出る.
+//    1 では暗い表示の処理をコンパイルしない).
+//    列スキャン割込みのCPU負荷は scan_load_permille (0.1%単位, 1秒ごとに更新) を,
+//    1回の最大処理時間は scan_isr_max_counts (CMTカウント, 0.32us単位) をデバッガで見る.
+//
+//  ・入力待ちやアニメーション待ちの状態では wait() でCPUを止め, 割込みで起きる(スリープモード).
+//    止まっていた時間の割合は idle_sleep_permille (0.1%単位, 1秒ごとに更新) をデバッガで見る.
+//    デバッガでステップ実行するときなどは IDLE_NO_SLEEP を定義すると止めない.
+//
+//  ・調査用のシリアル出力は SCI1 (TXD1 = P26, RXD1 = P30, 57600bps 8N1). sci_out.h を参照.
+//    STATE_PROFILE を定義すると状態ごとの滞在時間と遷移の履歴を取り, 'p' を受信すると送る.
+//    ISR_PROFILE を定義すると割込みごとの処理時間と入口の遅れのヒストグラムを取り, 'i' を受信すると送る.
+//    最悪値は isr_stat[].max_counts, max_latency, 割込みごとの負荷は isr_load_permille をデバッガでも見られる.
+//    どちらも 'c' で消す.
+//
+//  ・棋譜は1手1バイトで RAM のリング(record_moves, record_games)に残す. 'g' を受信すると
+//    host/tune_eval の棋譜フォーマットで送る. RECORD_FLASH を定義すると終わった局をE2データフラッシュにも残し,
+//    'f' で送る(data_flash.h を参照). 棋譜の任意の手数の局面は record_replay で作り直せる.
+//
+//  ・対局中は TURN_SWITCH ごとに盤面, 手番, ゲームの状態, カーソルをE2データフラッシュに残し(中断局面),
+//    リセットや電源断の後の起動で続きから始める(resume_flash.h を参照). 使わないときは RESUME_NO_FLASH を定義する.
+//    続けた局の棋譜は続けた局面から始まる新しい局として残す(RECORD_RESUMED).
+//
+//  ・起動の各段階の時刻は boot_us (CMT0 の開始からの us) をデバッガで見る.
+//    boot_us[BOOT_FIRST_FRAME] が電源投入(クロック設定後)からマトリックスLEDに盤面が出るまでの時間.
+//
+//  ・1ms より長い周期の処理と時間切れは CMT0 の1msで動くソフトウェアタイマ(timer_wheel.h)に登録する.
+//    CMT1 は列スキャン専用(ビットプレーンごとに周期を変えるため). CMT2 は使わない.
+//
+//  ・効果音は melody_play にフレーズ(struct Note の配列)を渡す. 待たずに戻り, CMT0 の割込みが鳴らす.
+//
+//  ・LCDの待ち時間は CMT3 (フリーラン, 割込みなし) で計り, LCD_RW が配線されていればビジーフラグを読む.
+//    LCD_RW を GND に固定した基板では lcd_lib4.h のインクルード前に LCD_NO_BUSY_FLAG を定義する.
 //
 //  ・ AI VS AI を観たいときは
 //    1. init_Game関数の g->is_AI_turn を1にする
 //    2. case INIT_GAME の state = TURN_START; のコメントアウトを外し、state = SELECT_WAIT; をコメントアウトする
-//    3. 自動初期化して連続対戦させたいときはcase END_SHOW の state = INIT_HW; のコメントアウトを外し、state = END_WAIT; をコメントアウトする
+//    3. 自動初期化して連続対戦させたいときはcase END_RESULT の state = INIT_HW; のコメントアウトを外し、state = END_WAIT; をコメントアウトする
 //
 //  入力機能
 //  ・ロータリーエンコーダー : カーソル移動
-//  ・sw5                  : 2〜3秒長押しでリセット
+//  ・sw5                  : 3秒長押しでリセット
 //  ・sw6                  : サウンドオンオフ
 //  ・sw7                  : 決定
 //  ・sw8                  : 移動方向オプション選択 ONで縦移動モード OFFで横移動モード
+//  sw6, sw7, ロータリーエンコーダー, sw5 の長押しは割込みが入力イベントキューに積み, メインループが取り出す.
+//  チャタリング除去はスイッチごと. キューが満杯で捨てたイベントの数は input_dropped をデバッガで見る.
 /************************************************************************************************/
 // #include "typedefine.h"
 #ifdef __cplusplus
@@ -32,77 +74,149 @@
 #endif
 
 #include <string.h>
+#include <stddef.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <machine.h>
 #include "iodefine.h"
 #include "vect.h"
+#include "clock_config.h"
 #include "lcd_lib4.h"
 #include "onkai.h"
+#include "othello_ai.h"
+// #define MATRIX_OUT_RSPI // マトリックスLEDを RSPI0 + DTC で出力する (matrix_out.h 参照)
+#include "matrix_out.h"
+#include "timer_wheel.h"
+#include "sci_out.h"
+#include "data_flash.h"
+#ifndef RESUME_NO_FLASH
+#include "resume_flash.h"
+#endif
+// #define STATE_PROFILE // 状態の滞在時間と遷移の履歴を取る
+// #define ISR_PROFILE   // 割込みの処理時間と入口の遅れを取る
+// #define STACK_CHECK   // スタックの最大使用量を取る
+// #define RECORD_FLASH  // 終わった局の棋譜をデータフラッシュに残す
+// #define RESUME_NO_FLASH // 中断局面をデータフラッシュに残さない
 
 /************************************ マクロ *************************************************/
 // 時間、周期
-#define MONITOR_CHATTERING_PERIOD_MS 300  // チャタリング監視周期. IRQ用.
+#define MONITOR_CHATTERING_PERIOD_MS 300  // チャタリング監視周期. スイッチごと.
 #define CURSOR_BLINK_PERIOD_MS       150  // カーソルの点滅周期
 #define AI_MOVE_PERIOD_MS            300  // AIの移動周期
 #define LINE_UP_RESULT_PERIOD_MS     200  // 結果表示でコマを並べる周期
 #define SHOW_RESULT_WAIT_MS          3000 // 結果表示の時間
 
-// ロータリーエンコーダー
-#define PULSE_DIFF_PER_CLICK 4 // 1クリックの位相計数
-#define UINT16T_MAX 65535      // MTU1.TCNTの最大値...符号なし16ビット
+// マトリックスLEDの列スキャン
+#ifndef SCAN_COL_PERIOD_US
+#define SCAN_COL_PERIOD_US 2000 // 1列の周期[us]. 1画面8列なので 2000 で62.5Hz, 250 で500Hz.
+#endif
+#ifndef SCAN_ON_TIME_PCT
+#define SCAN_ON_TIME_PCT   100  // 1列の周期のうち点灯させる割合[%]. 100 未満なら消灯のためにもう1回割り込む.
+#endif
+#define CMT_COUNTS_PER_MS  (CLK_PCLKB_HZ / 8 / 1000UL)                       // CMTのカウント数/ms (PCLKB 8分周)
+#define SCAN_COL_COUNTS    (SCAN_COL_PERIOD_US * CMT_COUNTS_PER_MS / 1000UL) // 1列の周期のカウント数
+#define SCAN_ON_COUNTS     (SCAN_COL_COUNTS * SCAN_ON_TIME_PCT / 100)        // 点灯時間のカウント数
+
+// 明るさ(ビットコード変調). 1列の点灯時間をビットプレーン k ごとに 1 : 2 : 4 ... に分け, 明るさ値のビット k が
+// 1 のLEDをその間だけ点灯する. ビットプレーンの切り替えごとに列スキャン割込みが入る.
+// BCM_PLANES を 2 以上にすると列スキャン割込みが列ごとにその回数入る. 負荷は scan_load_permille,
+// scan_isr_max_counts を実機で見てから上げる.
+#ifndef BCM_PLANES
+#define BCM_PLANES         1    // ビットプレーン数. 明るさは 0 〜 (1 << BCM_PLANES) - 1. 1 なら点灯/消灯のみ.
+#endif
+#define BCM_FULL_LEVEL     ((1 << BCM_PLANES) - 1)                           // コマの明るさ
+#define BCM_DIM_LEVEL      1                                                 // 置ける場所, AIの最後の手の明るさ
+#define BCM_UNIT_COUNTS    (SCAN_ON_COUNTS / BCM_FULL_LEVEL)                  // ビットプレーン0の点灯カウント数
+#define BCM_PLANE_COUNTS(k) (((k) == BCM_PLANES - 1) ? (SCAN_ON_COUNTS - BCM_UNIT_COUNTS * ((1UL << (k)) - 1)) \
+                                                    : (BCM_UNIT_COUNTS << (k))) // ビットプレーン k の点灯カウント数. 端数は最後に足す.
+
+#if (SCAN_COL_COUNTS > 65536) || (BCM_UNIT_COUNTS < 1)
+#error "SCAN_COL_PERIOD_US, SCAN_ON_TIME_PCT, BCM_PLANES が CMT1 で作れる範囲を超えている"
+#endif
+#if ((CLK_PCLKB_HZ / 8) % 1000UL) || (CMT_COUNTS_PER_MS > 65536)
+#error "CMT (PCLKB 8分周) で1msを作れない. clock_config.h の PCLKB を見直す."
+#endif
+#if defined(MATRIX_OUT_RSPI) && ((SCAN_ON_TIME_PCT < 100) || (BCM_PLANES > 1))
+#error "MATRIX_OUT_RSPI では列の途中で出力を変えられないので SCAN_ON_TIME_PCT は 100, BCM_PLANES は 1 にする"
+#endif
+
+// 暗い点灯(置ける場所, AIの最後の手). BCM_PLANES = 1 では表示できないので, 置ける場所を調べることもしない.
+#if BCM_PLANES > 1
+#define HINT_CLEAR()             clear_hints()
+#define HINT_PLACEABLE(brd, sc)  hint_placeable((brd), (sc))
+#define HINT_LAST_MOVE(x, y, sc) hint_last_move((x), (y), (sc))
+#else
+#define HINT_CLEAR()
+#define HINT_PLACEABLE(brd, sc)
+#define HINT_LAST_MOVE(x, y, sc)
+#endif
+
+// 状態プロファイラ
+#define PROF_TRACE_SIZE 64 // 遷移の履歴の数(2のべき乗)
+
+// 割込みプロファイラ
+#define ISR_HIST_BINS   17     // ヒストグラムのビン数. ビン k は [2^(k-1), 2^k) カウント(ビン0 は 0). 最後のビンが 65535 まで.
+#define ISR_NO_LATENCY  0xFFFF // 入口の遅れを計れない割込み(外部割込みなど)
+
+#ifdef ISR_PROFILE
+#define ISR_ENTER(v, latency) isr_enter((v), (latency))
+#define ISR_EXIT(v)           isr_exit(v)
+#else
+#define ISR_ENTER(v, latency)
+#define ISR_EXIT(v)
+#endif
+
+// 棋譜. 1手1バイトで, b5-0 = y * 8 + x, RECORD_SKIP = スキップ. 赤から打ち始め, 手番は交互.
+#define RECORD_BUF_SIZE   512                      // 手のリングのバイト数(2のべき乗)
+#define RECORD_GAMES      8                        // 覚えておく局数(2のべき乗)
+#define RECORD_MAX_MOVES  120                      // 1局の最大手数. スキップは相手が置く前にしか起きないので 60 × 2.
+#define RECORD_MOVE(x, y) ((unsigned char)((y) * MAT_WIDTH + (x)))
+#define RECORD_SKIP       0x40
+#define RECORD_VS_AI      0x01                     // flags : AI対戦
+#define RECORD_AI_FIRST   0x02                     // flags : 赤(先手)がAI
+#define RECORD_RESUMED    0x04                     // flags : 中断局面から続けた局. 手は start_board から.
+#define RECORD_DONE       0x80                     // flags : 最後まで打った
+
+// データフラッシュの棋譜. 1局1ブロックで, 通し番号の順にブロックを回して使う.
+#define RECORD_DF_FIRST_BLOCK 0                    // 先頭のブロック
+#define RECORD_DF_BLOCKS      48                   // ブロック数 (残りは中断局面用)
+#define RECORD_DF_MAGIC       0x4752               // ブロックの先頭. 最後に書くので, これがあれば書き終わっている.
+
+// 中断局面 (resume_flash.h) は棋譜の後ろのブロックを使う
+#if !defined(RESUME_NO_FLASH) && (RECORD_DF_FIRST_BLOCK + RECORD_DF_BLOCKS > RESUME_DF_FIRST_BLOCK)
+#error "棋譜のブロックが中断局面のブロック(RESUME_DF_FIRST_BLOCK)と重なっている"
+#endif
+
+// スタックの最大使用量
+#define STACK_PAINT        0xA5A5A5A5UL // 起動時に塗る値
+#define STACK_PAINT_MARGIN 16           // 今使っているスタックは今の位置からこの語数だけ離して塗る
 
-// 74HC595シフトレジスタのシリアルデータ送信コマンド
-#define SERIAL_SINK    do { PORT1.PODR.BIT.B5 = 0; } while(0)                        // 吸い込み
-#define SERIAL_SOURCE  do { PORT1.PODR.BIT.B5 = 1; } while(0)                        // 吐き出し
-#define SEND_LATCH_CLK do { PORT1.PODR.BIT.B6 = 1; PORT1.PODR.BIT.B6 = 0; } while(0) // ラッチ
-#define LATCH_OUT      do { PORT1.PODR.BIT.B7 = 1; PORT1.PODR.BIT.B7 = 0; } while(0) // ラッチ出力
+// アニメーション
+#define ANIM_QUEUE_SIZE 128 // アニメーションキューのフレーム数(2のべき乗). 結果表示の 8 + 64 + 1 フレームが入る.
+#define ANIM_NO_CHANGE  (-1) // フレームで盤面の列・カーソルを変えない
 
-// マトリックスLED
-#define COL_EN PORTE.PODR.BYTE  // 点灯列許可ビット選択
+// メロディ
+#define MELODY_QUEUE_SIZE 32 // メロディキューの音符数(2のべき乗). 入りきらない音符は捨てる.
 
-// 盤面
-#define MAT_WIDTH  8 // 横のコマ数
-#define MAT_HEIGHT 8 // 縦のコマ数
+// ロータリーエンコーダー
+#define PULSE_DIFF_PER_CLICK 4 // 1クリックの位相計数
+
+// 入力イベント
+#define INPUT_QUEUE_SIZE     64   // 入力イベントキューのイベント数(2のべき乗). 満杯のときは新しいイベントを捨てる.
+#define RESET_HOLD_PERIOD_MS 1000 // リセットボタン(sw5)を押している間, この周期でイベントを出す
+#define RESET_HOLD_COUNT     3    // この回数続けて押されていたらリセット
 
 // リセットボタン オン
 #define RESET_BTN_ON (PORTH.PIDR.BIT.B0 == 0)
 
 // 移動オプション
 #define MOVE_TYPE_UP_DOWN (PORTH.PIDR.BIT.B3 == 0) // 上下方向移動モード
-
-// AIの先読みの回数
-#define AI_DEPTH 4
-
-// 評価関数の重み係数定義. どの要素をどれくらい重要視するか.
-#define POS_WEIGHT      7   // 位置評価の重み係数
-#define MOBILITY_WEIGHT 3   // 配置可能数評価の重み係数
-#define STABLE_WEIGHT   30  // 確定石数（４つ角）評価の重み係数
-
-// 無限大の代わりに使用する大きな値
-#define INF 100000
 /********************************************************************************************/
 
 
 /********************************************* 定数 *************************************************/
-// 置き判定の時の8方向の移動量
-//                        　　　　上       下       左       右      左上      左下     右上     右下
-static const int DXDY[8][2] = {{0, 1}, {0, -1}, {-1, 0}, {1, 0}, {-1, 1}, {-1, -1}, {1, 1}, {1, -1}};
-
 // KEY = C majスケール
 static const unsigned int C_SCALE[MAT_HEIGHT] = {DO1, RE1, MI1, FA1, SO1, RA1, SI1, DO2};
-
-// 盤面のスコア定義
-static const int POSITION_WEIGHTS[MAT_HEIGHT][MAT_WIDTH] =
-{
-    {120, -40,  20,  10,  10,  20, -40, 120},
-    {-40, -50,  -5,  -5,  -5,  -5, -50, -40},
-    { 20,  -5,  15,  10,  10,  15,  -5,  20},
-    { 10,  -5,  10,   5,   5,  10,  -5,  10},
-    { 10,  -5,  10,   5,   5,  10,  -5,  10},
-    { 20,  -5,  15,  10,  10,  15,  -5,  20},
-    {-40, -50,  -5,  -5,  -5,  -5, -50, -40},
-    {120, -40,  20,  10,  10,  20, -40, 120}
-};
 /*******************************************************************************************/
 
 
@@ -149,8 +263,12 @@ enum State {
     // ゲーム終了フェーズ
     END_CALC,
     END_SHOW,
+    END_LINE_UP,
+    END_RESULT,
     END_WAIT,
-    END_RESET
+    END_RESET,
+
+    STATE_COUNT // 状態の数
 };
 
 // コマが動く方角
@@ -161,18 +279,26 @@ enum Direction{
     DOWN
 };
 
-// マトリックスLEDの色
-enum stone_color{
-    stone_red,  // 赤コマ
-    stone_green,// 緑コマ
-    stone_black // 何も置かれていない
+// 入力イベントの発生元
+enum InputType{
+    INPUT_SW6,        // サウンドオンオフ
+    INPUT_SW7,        // 決定
+    INPUT_ROTARY,     // ロータリーエンコーダー. value = クリック数(左回りが正)
+    INPUT_RESET_HOLD, // リセットボタン長押し. value = RESET_HOLD_PERIOD_MS の何回目か
+    INPUT_SOURCES
 };
 
-// ロータリーエンコーダー
-struct Rotary{
-    unsigned int current_cnt; // 現在のカウント数を保持
-    unsigned int prev_cnt;    // 過去のカウント数を保持
-    int dir;
+// 入力イベント. 割込みが積み, メインループが取り出す.
+struct InputEvent{
+    unsigned long time_ms; // 発生時刻(tc_1ms)
+    unsigned char type;    // enum InputType
+    signed char   value;
+};
+
+// 状態が受け取るまでためておく入力
+struct PendingInput{
+    int decide; // sw7 の押された回数
+    int clicks; // ロータリーエンコーダーのクリック数(左回りが正)
 };
 
 // カーソル
@@ -184,6 +310,92 @@ struct Cursor{
     enum stone_color color; // カーソルの色
 };
 
+// アニメーションのフレーム. 表示の変化, 音, 次のフレームまでの時間の組.
+struct AnimFrame{
+    signed char col;         // 書き換える列 (ANIM_NO_CHANGE = 盤面は変えない)
+    signed char cursor_x;    // カーソルの移動先 (ANIM_NO_CHANGE = 動かさない)
+    signed char cursor_y;
+    uint16_t    rg_data;     // 書き換える列の赤緑データ
+    uint16_t    tone;        // 鳴らす音 (0 = 鳴らさない)
+    uint16_t    tone_ms;     // 鳴らす時間
+    uint16_t    duration_ms; // 次のフレームまでの時間
+};
+
+// 音符. フレーズは ms = 0 の音符で終わる.
+struct Note{
+    uint16_t tone; // onkai.h の音 (KU = 休符)
+    uint16_t ms;   // 長さ
+};
+
+// 起動の段階
+enum BootStage{
+    BOOT_CMT0,        // CMT0 の開始 (時刻の基準)
+    BOOT_LCD_QUEUED,  // LCDの初期化手順を積んだ
+    BOOT_PERIPHERALS, // 周辺機能の初期化が終わった
+    BOOT_FIRST_FRAME, // マトリックスLEDに最初のフレームを出した
+    BOOT_STAGES
+};
+
+// 状態ごとの滞在時間
+struct StateStat{
+    unsigned long count;    // 抜けた回数
+    unsigned long min_us;   // 最短
+    unsigned long max_us;   // 最長
+    uint64_t      total_us; // 合計
+};
+
+// 状態の遷移
+struct StateTrace{
+    unsigned long  time_us; // 遷移した時刻 (boot_now_us)
+    unsigned char  from;    // enum State
+    unsigned char  to;
+    unsigned short repeat;  // 同じ遷移を続けて繰り返した回数 (往復の待ち状態)
+};
+
+// 計測する割込み
+enum IsrVector{
+    ISR_CMT0,     // 1msタイマ
+    ISR_CMT1,     // 列スキャン
+    ISR_RSPI0,    // 列スキャン (MATRIX_OUT_RSPI)
+    ISR_IRQ0,     // sw6
+    ISR_IRQ1,     // sw7
+    ISR_SCI1_TXI, // 調査用シリアル送信
+    ISR_VECTORS
+};
+
+// 割込みごとの処理時間と入口の遅れ. 時間はすべて CMT のカウント (PCLKB/8, 0.32us).
+struct IsrStat{
+    unsigned long count;                     // 回数
+    unsigned int  max_counts;                // 処理時間の最大
+    unsigned int  max_latency;               // 入口の遅れの最大 (コンペアマッチから入口まで)
+    unsigned long busy_counts;               // 処理時間の積算 (1秒ごとに isr_load_permille にして消す)
+    unsigned long dur_hist[ISR_HIST_BINS];   // 処理時間のヒストグラム
+    unsigned long lat_hist[ISR_HIST_BINS];   // 入口の遅れのヒストグラム (遅れを計れる割込みのみ)
+    unsigned int  start;                     // 入口での CMT3.CMCNT
+};
+
+// 1局の棋譜. 手は record_moves のリングにある.
+struct GameRecord{
+    unsigned long  start; // 最初の手の位置 (record_wp と同じ通し番号)
+    unsigned short seed;  // INIT_GAME で srand に渡した値
+    unsigned char  flags; // RECORD_VS_AI, RECORD_AI_FIRST, RECORD_RESUMED, RECORD_DONE
+    unsigned char  count; // 手数 (スキップを含む)
+    unsigned char  start_color; // RECORD_RESUMED のとき最初の手番
+    struct PackedBoard start_board; // RECORD_RESUMED のとき最初の局面
+};
+
+// データフラッシュの棋譜ブロックの先頭. 続けて手を count バイト置く.
+struct GameRecordHeader{
+    uint16_t      magic;  // RECORD_DF_MAGIC
+    uint16_t      seq;    // 通し番号
+    uint16_t      seed;
+    unsigned char flags;
+    unsigned char count;
+    unsigned char start_color;
+    unsigned char reserved;
+    struct PackedBoard start_board;
+};
+
 // プレイヤー情報
 struct Player{
 	int placeable_count; // 配置可能数
@@ -192,44 +404,126 @@ struct Player{
 
 // ゲーム状態
 struct Game{
-	int count_to_reset;   // リセットボタンのカウント数
 	int is_buzzer_active; // サウンドはオンかオフか？
 	int is_vs_AI;         // AI対戦モードか？
 	int is_AI_turn;       // AIのターンか？
 	int is_skip;          // スキップか？
 };
-
-// 手の情報を保持する. AI推論用
-struct Move{
-    int x;     // x座標
-    int y;     // y座標
-    int score; // 手のスコア
-};
 /****************************************************************************************/
 
 
+/********************************************* フレーズ *************************************************/
+// パス
+static const struct Note PHRASE_SKIP[] = {{SO2, 80}, {KU, 40}, {SO2, 80}, {0, 0}};
+
+// 結果発表
+static const struct Note PHRASE_RESULT[] = {{DO2, 120}, {MI2, 120}, {SO2, 120}, {KU, 60}, {DO3, 400}, {0, 0}};
+/*******************************************************************************************/
+
+
 /************************************* 割り込み使用グローバル変数 ********************************************/
 static volatile unsigned long tc_1ms;                                    // 1msタイマーカウンター
-static volatile unsigned long tc_2ms;                                    // 2msタイマーカウンター
-static volatile unsigned long tc_10ms;                                   // 10msタイマーカウンター
-static volatile unsigned long tc_IRQ;                                    // IRQ発生時のタイマカウンター
-static volatile unsigned char IRQ1_flag;                                 // IRQ1発生フラグ(sw7)
-static volatile unsigned int  beep_period_ms;                            // ブザーを鳴らす時間(1ms基準)
-static volatile enum          stone_color screen[MAT_HEIGHT][MAT_WIDTH]; // 割り込みで描画に使用.
-static volatile struct        Game *Game_inst_ISR;                       // ISR用Gameインスタンス. IRQ0で使用.
+static volatile unsigned long boot_us[BOOT_STAGES];                      // 起動の段階ごとの時刻[us]
+static volatile unsigned char boot_stamped;                              // 記録済みの段階のビット
+static volatile unsigned long tc_scan;                                   // 列スキャンカウンター(SCAN_COL_PERIOD_US ごと)
+static volatile unsigned char scan_phase;                                // 列の中の位置. 0〜BCM_PLANES-1 = ビットプレーン, BCM_PLANES = 消灯.
+static volatile unsigned char scan_col;                                  // 表示中の列
+static volatile unsigned long scan_busy_counts;                          // 列スキャン割込みの処理時間の積算(CMTカウント)
+static volatile unsigned int  scan_load_permille;                        // 列スキャン割込みのCPU負荷[0.1%]. 1秒ごとに更新.
+static volatile unsigned int  scan_isr_max_counts;                       // 列スキャン割込み1回の最大処理時間(CMTカウント)
+static volatile unsigned long idle_sleep_counts;                         // wait() で止まっていた時間の積算(CMTカウント)
+static volatile unsigned int  idle_sleep_permille;                       // wait() で止まっていた時間の割合[0.1%]. 1秒ごとに更新.
+static struct                InputEvent input_queue[INPUT_QUEUE_SIZE];  // 入力イベントキュー. 割込みが書き, メインが取り出す.
+static volatile unsigned int  input_wp;                                  // 書き込み位置(割込み)
+static volatile unsigned int  input_rp;                                  // 読み出し位置(メイン)
+static volatile unsigned int  input_dropped;                             // キューが満杯で捨てたイベントの数
+static unsigned long          input_last_ms[INPUT_SOURCES];              // 発生元ごとの最後のイベントの時刻(チャタリング除去)
+static uint16_t               input_rotary_last;                         // 前回読んだ MTU1.TCNT
+static int                    input_rotary_acc;                          // クリックに満たない位相計数
+static unsigned int           input_reset_ms;                            // リセットボタンを押し続けている時間
+static struct                Note melody_queue[MELODY_QUEUE_SIZE];      // メロディキュー. メインが書き, 1ms割込みが鳴らす.
+static volatile unsigned int  melody_wp;                                 // 書き込み位置(メイン)
+static volatile unsigned int  melody_rp;                                 // 読み出し位置(割込み)
+static volatile unsigned int  melody_flush_to;                           // この位置より前の音符を捨てる
+static volatile unsigned char melody_flush_req;                          // 音符の破棄要求
+static struct                SoftTimer melody_timer;                    // 鳴らしている音符の終わり
+static struct                SoftTimer anim_timer;                      // アニメーション (1ms周期)
+static struct                SoftTimer input_timer;                     // 入力イベント (1ms周期)
+static struct                SoftTimer lcd_timer;                       // LCD送信 (1ms周期)
+static struct                SoftTimer scan_load_timer;                 // 列スキャンのCPU負荷 (1秒周期)
+static struct                SoftTimer state_timer;                     // 状態の時間切れ (メインが見る)
+static volatile uint16_t      frame_buf[2][BCM_PLANES][MAT_WIDTH];      // ビットプレーン・列ごとの赤緑データ(b15-8 赤, b7-0 緑). 表示面と書き込み面.
+static volatile unsigned char frame_front;                               // 割込みで表示している面
+static volatile unsigned char frame_swap_req;                            // 書き込み面の完成通知. 次のフレームの先頭で切り替える.
+static struct                AnimFrame anim_queue[ANIM_QUEUE_SIZE];     // アニメーションキュー. メインが書き, 1ms割込みが取り出す.
+static volatile unsigned int  anim_wp;                                   // 書き込み位置(メイン)
+static volatile unsigned int  anim_rp;                                   // 読み出し位置(割込み)
+static volatile unsigned int  anim_remain_ms;                            // 表示中のフレームの残り時間
+static volatile unsigned char anim_cancel_req;                           // キューの破棄要求
 static volatile struct        Cursor cursor;                             // Cursorインスタンス
 /************************************************************************************************************/
 
 
+/************************************************** 棋譜用グローバル変数 **************************************************/
+static unsigned char     record_moves[RECORD_BUF_SIZE]; // 手のリング. 古い局から上書きする.
+static unsigned long     record_wp;                     // 次に書く位置 (通し番号)
+static struct GameRecord record_games[RECORD_GAMES];    // 局のリング
+static unsigned int      record_game_no;                // 今の局の番号 (起動してからの通し番号, 1 から)
+#ifdef RECORD_FLASH
+static uint16_t          record_df_seq;                 // 次にデータフラッシュに書く局の通し番号
+static unsigned char     record_df_ok;                  // データフラッシュが使える
+#endif
+/***************************************************************************************************************************/
+
+
+/************************************************** 中断局面用グローバル変数 **************************************************/
+#ifndef RESUME_NO_FLASH
+static unsigned char resume_tried;  // 起動後の続きから始める判定を済ませた (他は resume_flash.h)
+#endif
+/***************************************************************************************************************************/
+
+
+/************************************************** 状態プロファイラ用グローバル変数 **************************************************/
+#ifdef STATE_PROFILE
+static struct StateStat  prof_stat[STATE_COUNT];         // 状態ごとの滞在時間
+static struct StateTrace prof_trace[PROF_TRACE_SIZE];    // 遷移の履歴 (リングバッファ)
+static unsigned int      prof_trace_wp;                  // 次に書く位置
+static unsigned long     prof_enter_us;                  // 今の状態に入った時刻
+#endif
+/***************************************************************************************************************************/
+
+
+/************************************************** 割込みプロファイラ用グローバル変数 **************************************************/
+#ifdef ISR_PROFILE
+static volatile struct IsrStat isr_stat[ISR_VECTORS];            // 割込みごとの計測値. 全ての割込みが優先度1 (RSPI0 SPRI0 も) なので入れ子にならない.
+static volatile unsigned int   isr_load_permille[ISR_VECTORS];   // 割込みごとのCPU負荷[0.1%]. 1秒ごとに更新.
+#endif
+/***************************************************************************************************************************/
+
+
+/************************************************** 表示用グローバル変数 **************************************************/
+static unsigned char frame_dirty_cols = 0xFF;       // 前回のフラッシュから変わった列のビット(b0 = x0)
+static unsigned char frame_last_back  = 0xFF;       // 前回のフラッシュで書き込んだ面
+#if BCM_PLANES > 1
+static uint16_t      frame_hint[MAT_WIDTH];         // 列ごとに BCM_DIM_LEVEL で点灯させる赤緑データ
+#endif
+/***************************************************************************************************************************/
+
+
 /************************************************** AI推論用グローバル変数 **************************************************/
-// グローバル静的バッファ
-static enum stone_color ai_buf[AI_DEPTH + 1][MAT_HEIGHT][MAT_WIDTH]; // 深さごとのシミュレーションバッファ
-static int              ai_entry_idx[MAT_HEIGHT * MAT_WIDTH];        // ソートに対応させるための座標配列のインデックス
-static struct Move      ai_moves[AI_DEPTH][MAT_HEIGHT * MAT_WIDTH];  // 各深さでの候補手リスト
-static int              ai_move_counts[AI_DEPTH];                    // 各深さでの候補手数
+// 探索バッファ本体は othello_ai.h
+static int ai_entry_idx[MAT_HEIGHT * MAT_WIDTH]; // ソートに対応させるための座標配列のインデックス
 /***************************************************************************************************************************/
 
 
+/*************************************** プロトタイプ宣言 ***************************************/
+// ソフトウェアタイマのコールバック (init_timers で登録)
+void anim_tick(void);
+void input_tick(void);
+void scan_load_update(void);
+/*************************************************************************************************/
+
+
 /************************************************** 関数定義 **************************************************/
 /********************************************** ハードウェア初期化 *********************************************/
 void init_PORT(void)
@@ -258,7 +552,7 @@ void init_CLK(void)
         ;
     for (i = 0; i < 100; i++)
         nop();
-    SYSTEM.PLLCR.WORD = 0x0901;
+    SYSTEM.PLLCR.WORD = CLK_PLLCR;
     SYSTEM.PLLWTCR.BYTE = 0x09;
     SYSTEM.PLLCR2.BYTE = 0x00;
     for (i = 0; i < 100; i++)
@@ -266,8 +560,8 @@ void init_CLK(void)
     SYSTEM.OPCCR.BYTE = 0x00;
     while (0 != SYSTEM.OPCCR.BIT.OPCMTSF)
         ;
-    SYSTEM.SCKCR.LONG = 0x21821211;
-    while (0x21821211 != SYSTEM.SCKCR.LONG)
+    SYSTEM.SCKCR.LONG = CLK_SCKCR; // 分周は clock_config.h
+    while (CLK_SCKCR != SYSTEM.SCKCR.LONG)
         ;
     SYSTEM.SCKCR3.WORD = 0x0400;
     while (0x0400 != SYSTEM.SCKCR3.WORD)
@@ -280,7 +574,7 @@ void init_CMT0(void)
     SYSTEM.PRCR.WORD = 0x0A502;
     MSTP(CMT0) = 0;
     SYSTEM.PRCR.WORD = 0x0A500;
-    CMT0.CMCOR = 25000 / 8 - 1;
+    CMT0.CMCOR = CMT_COUNTS_PER_MS - 1;
     CMT0.CMCR.WORD |= 0x00C0;
     IEN(CMT0, CMI0) = 1;
     IPR(CMT0, CMI0) = 1;
@@ -292,25 +586,13 @@ void init_CMT1(void)
     SYSTEM.PRCR.WORD = 0x0A502;
     MSTP(CMT1) = 0;
     SYSTEM.PRCR.WORD = 0x0A500;
-    CMT1.CMCOR = (25000 * 2) / 8 - 1;
+    CMT1.CMCOR = SCAN_COL_COUNTS - 1;
     CMT1.CMCR.WORD |= 0x00C0;
     IEN(CMT1, CMI1) = 1;
     IPR(CMT1, CMI1) = 1;
     CMT.CMSTR0.BIT.STR1 = 1;
 }
 
-void init_CMT2(void)
-{
-    SYSTEM.PRCR.WORD = 0x0A502;
-    MSTP(CMT2) = 0;
-    SYSTEM.PRCR.WORD = 0x0A500;
-    CMT2.CMCOR = (25000 * 10) / 8 - 1;
-    CMT2.CMCR.WORD |= 0x00C0;
-    IEN(CMT2, CMI2) = 1;
-    IPR(CMT2, CMI2) = 1;
-    CMT.CMSTR1.BIT.STR2 = 1;
-}
-
 void init_IRQ0(void)
 {
 	IEN(ICU, IRQ0) = 0;
@@ -357,7 +639,7 @@ void init_BUZZER(void)
     MPC.P34PFS.BIT.PSEL = 1;
     MPC.PWPR.BIT.PFSWE = 0;
     MTU.TSTR.BIT.CST0 = 0x00;
-    MTU0.TCR.BIT.TPSC = 0x01;
+    MTU0.TCR.BIT.TPSC = ONKAI_MTU_TPSC; // 音階表(onkai.h)と同じ分周
     MTU0.TCR.BIT.CCLR = 0x01;
     MTU0.TMDR.BIT.MD = 0x02;
     MTU0.TIORH.BIT.IOA = 0x06;
@@ -399,38 +681,166 @@ void init_AD0(void)
     MPC.PWPR.BIT.PFSWE = 0;
 }
 
+// CMT0 の1msで動くソフトウェアタイマに周期処理を登録する. LCD送信は init_RX210 で先に登録する.
+void init_timers(void)
+{
+    tw_start(&anim_timer,      1,    1,    anim_tick);
+    tw_start(&input_timer,     1,    1,    input_tick);
+    tw_start(&scan_load_timer, 1000, 1000, scan_load_update);
+}
+
+// CMT0 の開始からの時刻[us]. 割込み禁止中に1msをまたいだときは CMT0 の割込み要求を見て補う.
+unsigned long boot_now_us(void)
+{
+    unsigned long ms;
+    unsigned int  cnt, pending;
+
+    do
+    {
+        ms      = tc_1ms;
+        cnt     = CMT0.CMCNT;
+        pending = IR(CMT0, CMI0);
+    }
+    while(ms != tc_1ms);
+
+    if(pending && (cnt < CMT_COUNTS_PER_MS / 2)) ms++;
+
+    return ms * 1000 + (unsigned long)cnt * 1000 / CMT_COUNTS_PER_MS;
+}
+
+// 起動の段階の時刻を記録する. 2回目以降は記録しない.
+void boot_stamp(enum BootStage stage)
+{
+    if(boot_stamped & (1 << stage)) return;
+
+    boot_us[stage] = boot_now_us();
+    boot_stamped |= 1 << stage;
+}
+
+// LCDの電源投入待ちと初期化手順の送信は CMT0 の割込みで行い, その間に他の周辺機能を初期化する.
 void init_RX210(void)
 {
     init_CLK();
+
+    // 起動時間の基準. ソフトウェアタイマはまだ空なので, すぐ割込みを許可してよい.
+    init_CMT0();
+    setpsw_i();
+    boot_stamp(BOOT_CMT0);
+
+    // LCDは初期化手順を積むだけで, 以降 CMT0 の割込みで送る
     init_LCD();
+    tw_start(&lcd_timer, 1, 1, lcd_tick);
+    lcd_start_async();
+    boot_stamp(BOOT_LCD_QUEUED);
+
     init_PORT();
-    init_CMT0();
+#ifdef MATRIX_OUT_RSPI
+    init_matrix_rspi();
+    init_matrix_dtc();
+#endif
     init_CMT1();
-    init_CMT2();
     init_IRQ0();
     init_IRQ1();
     init_BUZZER();
     init_MTU1();
     init_AD0();
-    setpsw_i();
+    init_SCI1();
+    init_timers();
+    boot_stamp(BOOT_PERIPHERALS);
 }
 /***********************************************************************************/
 /*********************************** ブザー ******************************************/
-void beep(unsigned int tone, unsigned int interval, int active)
+// ブザーの音を変える. 0 と KU は止める.
+void buzzer_out(unsigned int tone)
 {
-    if (tone && active)
+    MTU.TSTR.BIT.CST0 = 0;
+
+    if (tone > KU)
     {
-        MTU.TSTR.BIT.CST0 = 0;
         MTU0.TGRA = tone;
         MTU0.TGRB = tone / 2;
         MTU.TSTR.BIT.CST0 = 1;
     }
-    else
+}
+
+// 音符が終わったら次の音符を鳴らす. 無ければ止める. melody_timer のコールバック.
+void melody_next(void)
+{
+    const struct Note *n;
+
+    if(melody_flush_req)
+    {
+        melody_rp        = melody_flush_to;
+        melody_flush_req = 0;
+    }
+
+    if(melody_rp == melody_wp)
+    {
+        buzzer_out(0);
+        return;
+    }
+
+    n = &melody_queue[melody_rp & (MELODY_QUEUE_SIZE - 1)];
+
+    buzzer_out(n->tone);
+    tw_start(&melody_timer, n->ms, 0, melody_next);
+    melody_rp++;
+}
+
+// フレーズを鳴らす. 鳴っている音とキューの音符は捨てて, 次の1msでこのフレーズに切り替える.
+// 待たずに戻り, melody_timer の満了ごとに割込みが次の音符を鳴らす. active が 0 なら止めるだけ.
+// 書いている途中で melody_note_isr にキューを捨てられないよう, 書き終わるまで割込みを止める(数us).
+void melody_play(const struct Note *phrase, int active)
+{
+    unsigned long psw = get_psw();
+    unsigned int wp;
+
+    clrpsw_i();
+
+    wp = melody_wp;
+
+    // 割込みは音符を取り出す前に破棄要求を見るので, この後に積んだ音符は捨てられない
+    melody_flush_to  = wp;
+    melody_flush_req = 1;
+
+    // melody_flush_to より前は捨てる音符なので, 空きはそこから数える
+    for(; active && phrase->ms; phrase++)
     {
-        MTU.TSTR.BIT.CST0 = 0;
+        if(wp - melody_flush_to >= MELODY_QUEUE_SIZE) break;
+
+        melody_queue[wp & (MELODY_QUEUE_SIZE - 1)] = *phrase;
+        wp++;
+        melody_wp = wp;
     }
 
-    beep_period_ms = interval;
+    // 鳴っている音符の終わりを待たずに切り替える
+    tw_start(&melody_timer, 1, 0, melody_next);
+
+    set_psw(psw);
+}
+
+// 1音だけ鳴らす
+void beep(unsigned int tone, unsigned int interval, int active)
+{
+    struct Note note[2];
+
+    note[0].tone = (uint16_t)tone;
+    note[0].ms   = (uint16_t)interval;
+    note[1].tone = 0;
+    note[1].ms   = 0;
+
+    melody_play(note, active);
+}
+
+// 割込みから1音鳴らす. キューの音符は捨てる. CMT0 CMI0 の中から呼ぶ.
+// melody_play は割込みを止めて書くので, ここで捨てるのは書き終わったフレーズだけ.
+void melody_note_isr(unsigned int tone, unsigned int ms)
+{
+    melody_rp        = melody_wp;
+    melody_flush_req = 0;
+
+    buzzer_out(tone);
+    tw_start(&melody_timer, ms, 0, melody_next);
 }
 
 /********************************* LCD表示 ******************************************/
@@ -489,137 +899,409 @@ void lcd_show_confirm(void)
 /*************************************************************************************/
 
 
-/********************************** マトリックスLED ************************************/
-// 指定した列の赤緑データをマトリックスLEDに出力
-void col_out(int col, unsigned int rg_data)
+/*********************************** ロータリーエンコーダ ***********************************/
+// 位相計数用レジスタからカウント数を読み取る
+unsigned int read_rotary(void)
 {
-	int i;
+    return MTU1.TCNT;
+}
 
-    for(i = 0; i < MAT_WIDTH * 2; i++)
-	{
-		if(rg_data & (1 << i))
-		{
-			SERIAL_SINK;    // 点灯(カソード側吸い込み)
-		}
-		else
-		{
-			SERIAL_SOURCE;  // 消灯(カソード側吐き出し)
-		}
 
-		SEND_LATCH_CLK;     // ラッチ
-	}
+/**************************************************************************************/
 
-	COL_EN = 0;             // 全消灯
 
-	LATCH_OUT;              // ラッチ出力
+/*********************************** 入力イベント ***********************************/
+// 入力イベントを積む. IRQ0, IRQ1, CMT0 CMI0 から呼ぶ. 全ての割込みが優先度1で互いに割り込まないので,
+// 書き込み側は1つとみなせる. メイン側は input_rp しか書かないのでロックは要らない.
+void input_push(enum InputType type, int value)
+{
+    struct InputEvent *ev;
+    unsigned int wp = input_wp;
 
-	COL_EN = 1 << col;      // 点灯列指定
-}
-/******************************************************************************************/
+    if(wp - input_rp >= INPUT_QUEUE_SIZE)
+    {
+        input_dropped++;
+        return;
+    }
 
+    ev = &input_queue[wp & (INPUT_QUEUE_SIZE - 1)];
 
-/*********************************** ロータリーエンコーダ ***********************************/
-// 位相計数用レジスタからカウント数を読み取る
-unsigned int read_rotary(void)
-{
-    return MTU1.TCNT;
+    ev->time_ms = tc_1ms;
+    ev->type    = (unsigned char)type;
+    ev->value   = (signed char)value;
+
+    input_wp = wp + 1;
 }
 
-// アンダーフロー判定
-// 位相計数を PULSE_DIFF_PER_CLICK で割って 0～65535/4 にスケーリング
-int is_underflow(struct Rotary *r)
+// スイッチのチャタリング除去. 発生元ごとに前のイベントから MONITOR_CHATTERING_PERIOD_MS 以内なら捨てる.
+// 戻り値 : 1 = イベントにする
+int input_debounce(enum InputType type)
 {
-    return (UINT16T_MAX/PULSE_DIFF_PER_CLICK == r->current_cnt) && (r->prev_cnt == 0);
+    unsigned long now = tc_1ms;
+
+    if(now - input_last_ms[type] < MONITOR_CHATTERING_PERIOD_MS) return 0;
+
+    input_last_ms[type] = now;
+
+    return 1;
 }
 
-// オーバフロー判定
-// 位相計数を PULSE_DIFF_PER_CLICK で割って 0～65535/4 にスケーリング
-int is_overflow(struct Rotary *r)
+// ロータリーエンコーダーとリセットボタンを1ms周期で見てイベントにする. input_timer のコールバック.
+void input_tick(void)
 {
-    return (UINT16T_MAX/PULSE_DIFF_PER_CLICK == r->prev_cnt) && (r->current_cnt == 0);
+    uint16_t cnt = (uint16_t)read_rotary();
+    int clicks;
+
+    // 位相計数の差分. 16ビットで引くのでオーバーフロー・アンダーフローをまたいでもよい.
+    input_rotary_acc += (int16_t)(cnt - input_rotary_last);
+    input_rotary_last = cnt;
+
+    clicks = input_rotary_acc / PULSE_DIFF_PER_CLICK;
+
+    if(clicks)
+    {
+        input_rotary_acc -= clicks * PULSE_DIFF_PER_CLICK;
+        input_push(INPUT_ROTARY, clicks);
+    }
+
+    // リセットボタンは押している間 RESET_HOLD_PERIOD_MS ごとに知らせる
+    if(RESET_BTN_ON)
+    {
+        input_reset_ms++;
+
+        if(!(input_reset_ms % RESET_HOLD_PERIOD_MS))
+        {
+            input_push(INPUT_RESET_HOLD, input_reset_ms / RESET_HOLD_PERIOD_MS);
+        }
+    }
+    else
+    {
+        input_reset_ms = 0;
+    }
 }
 
-// 左回りしたか
-int is_rotary_turned_left(struct Rotary *r)
-{           // カウンター増加　　　　　　　または     オーバーフロー
-    return ((r->current_cnt > r->prev_cnt) || is_overflow(r));
+// 入力イベントを1つ取り出す. 戻り値 : 1 = 取り出した, 0 = 空
+int input_pop(struct InputEvent *ev)
+{
+    unsigned int rp = input_rp;
+
+    if(rp == input_wp) return 0;
+
+    *ev = input_queue[rp & (INPUT_QUEUE_SIZE - 1)];
+
+    input_rp = rp + 1;
+
+    return 1;
 }
 
-// 右回りしたか
-int is_rotary_turned_right(struct Rotary *r)
-{           // カウンター減少              または     アンダーフロー
-    return ((r->current_cnt < r->prev_cnt) || is_underflow(r));
+// 積まれている入力イベントを捨てる
+void input_flush(void)
+{
+    input_rp = input_wp;
 }
 /**************************************************************************************/
 
 
 /************************************** コマ/盤面 ********************************************* */
-// 何も置かれてないか, または何色が置かれているか
-enum stone_color read_stone_at(enum stone_color brd[][MAT_WIDTH], int x, int y)
+// 1列分の赤緑データを作る. b15-8 : 赤(y = 7..0), b7-0 : 緑(y = 7..0)
+uint16_t make_col_data(enum stone_color brd[][MAT_WIDTH], int x)
+{
+    int y;
+    uint16_t rg_data = 0x0000;
+
+    for(y = 0; y < MAT_HEIGHT; y++)
+    {
+        if(brd[y][x] == stone_red)
+        {
+            rg_data |= (1 << (y + 8));
+        }
+        else if(brd[y][x] == stone_green)
+        {
+            rg_data |= (1 << y);
+        }
+    }
+
+    return rg_data;
+}
+
+// 列 x の表示を更新する必要があることを記録する
+void mark_col_dirty(int x)
 {
-   return brd[y][x];
+    frame_dirty_cols |= 1 << x;
 }
 
-// 指定した色のコマを置く
-void place(enum stone_color brd[][MAT_WIDTH], int x, int y, enum stone_color sc)
+// 全列の表示を更新する必要があることを記録する
+void mark_board_dirty(void)
 {
-    brd[y][x] = sc;
+    frame_dirty_cols = 0xFF;
 }
 
-// 指定した座標のコマを消す
-void delete(enum stone_color brd[][MAT_WIDTH], int x, int y)
+#if BCM_PLANES > 1
+// 列 x の暗い点灯を hint にする. 変わったときだけ列を更新する.
+void set_col_hint(int x, uint16_t hint)
 {
-    brd[y][x] = stone_black;
+    if(frame_hint[x] == hint) return;
+
+    frame_hint[x] = hint;
+    mark_col_dirty(x);
 }
 
-// ローカルボードの内容を割込み用表示ボードにコピー（フラッシュ）
-void flush_board(enum stone_color brd[][MAT_WIDTH])
+// 暗い点灯(置ける場所, AIの最後の手)をすべて消す
+void clear_hints(void)
+{
+    int x;
+
+    for(x = 0; x < MAT_WIDTH; x++)
+    {
+        set_col_hint(x, 0x0000);
+    }
+}
+
+// 色 sc のコマを置ける場所を暗く点灯させる
+void hint_placeable(enum stone_color brd[][MAT_WIDTH], enum stone_color sc)
 {
     int x, y;
+    uint16_t hint;
 
     for(x = 0; x < MAT_WIDTH; x++)
     {
+        hint = frame_hint[x];
+
         for(y = 0; y < MAT_HEIGHT; y++)
         {
-            screen[y][x] = brd[y][x];
+            if(is_placeable(brd, x, y, sc))
+            {
+                hint |= (sc == stone_red) ? (1 << (y + 8)) : (1 << y);
+            }
         }
+
+        set_col_hint(x, hint);
     }
 }
-/*****************************************************************************/
 
-
-/****************************** カーソル **************************************/
-// カーソルの座標をセット
-void set_cursor_xy(int x, int y)
+// 色 sc が最後に置いたマスに, もう一方の色を暗く重ねて目立たせる
+void hint_last_move(int x, int y, enum stone_color sc)
 {
-    cursor.x = x;
-    cursor.y = y;
+    frame_hint[x] |= (sc == stone_red) ? (1 << y) : (1 << (y + 8));
+
+    mark_col_dirty(x);
 }
+#endif
 
-// カーソルの色をセット
-void set_cursor_color(enum stone_color sc)
+// 1列分のビットプレーンを作る. コマは BCM_FULL_LEVEL, 暗い点灯は BCM_DIM_LEVEL.
+// 明るさが1段階だけ(BCM_PLANES = 1)のときは暗い点灯はしない.
+void make_col_planes(enum stone_color brd[][MAT_WIDTH], int x, volatile uint16_t planes[][MAT_WIDTH])
 {
-    cursor.color = sc;
+    int k;
+    uint16_t stones = make_col_data(brd, x);
+#if BCM_PLANES > 1
+    uint16_t dim    = frame_hint[x] & ~stones;
+#else
+    uint16_t dim    = 0x0000;
+#endif
+
+    for(k = 0; k < BCM_PLANES; k++)
+    {
+        planes[k][x] = stones | (((BCM_DIM_LEVEL >> k) & 1) ? dim : 0x0000);
+    }
 }
 
-// 上下左右を指定してカーソルの座標を更新
-void move_cursor(enum Direction dir)
+// ローカルボードの内容を割込み用フレームバッファに書き込む（フラッシュ）
+// 表示中でない面を最新の状態にしてから切り替えを要求するので, 割込みが書きかけの面を表示することはない.
+// 作り直すのは mark_col_dirty で記録した列だけ.
+void flush_board(enum stone_color brd[][MAT_WIDTH])
 {
-    int cx = cursor.x;
-    int cy = cursor.y;
+    int x, k;
+    unsigned char back;
 
-    if (dir == LEFT)  // 左
-    {
-        // 左シフト
-        cx--;
+    // 書き込み中は切り替えさせない
+    frame_swap_req = 0;
 
-        // 左端まで行ったら一つ上の行の右端にワープ
-        if (cx < 0)
-        {
-        	cx = MAT_WIDTH - 1;
-        	cy++;
+    back = frame_front ^ 1;
 
-            // 上端を超えたら一番下の行にワープ
+    // 前回書いた面がもう表示されていたら, 書き込み面は古いので表示面の内容から始める
+    if(back != frame_last_back)
+    {
+        for(k = 0; k < BCM_PLANES; k++)
+        {
+            for(x = 0; x < MAT_WIDTH; x++)
+            {
+                frame_buf[back][k][x] = frame_buf[frame_front][k][x];
+            }
+        }
+    }
+
+    for(x = 0; x < MAT_WIDTH; x++)
+    {
+        if(frame_dirty_cols & (1 << x))
+        {
+            make_col_planes(brd, x, frame_buf[back]);
+        }
+    }
+
+    frame_dirty_cols = 0x00;
+    frame_last_back  = back;
+
+    frame_swap_req = 1;
+}
+
+// 割込みで出力する1列・1ビットプレーン分の赤緑データ. フレームの切り替えとカーソルの点滅を反映する.
+// カーソルはすべてのビットプレーンに重ねるので最も明るく点灯する.
+unsigned int scan_col_data(int x, int plane)
+{
+    unsigned int rg_data;
+
+    // フレームの先頭で書き込み済みの面に切り替える
+    if((x == 0) && (plane == 0) && frame_swap_req)
+    {
+        frame_front ^= 1;
+        frame_swap_req = 0;
+        boot_stamp(BOOT_FIRST_FRAME);
+    }
+
+    rg_data = frame_buf[frame_front][plane][x];
+
+    if((x != cursor.x) || (cursor.color == stone_black))
+    {
+        return rg_data;
+    }
+
+    // 一定間隔でカーソルを点滅させる
+    if((tc_1ms / CURSOR_BLINK_PERIOD_MS) % 2)
+    {
+        rg_data |= (cursor.color == stone_red) ? (1 << (cursor.y + 8)) : (1 << cursor.y);
+    }
+    else if(rg_data & ((1 << (cursor.y + 8)) | (1 << cursor.y)))
+    {
+        rg_data &= ~((1 << (cursor.y + 8)) | (1 << cursor.y));
+    }
+
+    return rg_data;
+}
+/*****************************************************************************/
+
+
+/****************************** アニメーション **************************************/
+// アニメーションキューにフレームを積む. 満杯のときは割込みが取り出すまで待つ.
+// col, cursor_x に ANIM_NO_CHANGE を指定するとその表示は変えない.
+void anim_push(int col, uint16_t rg_data, int cursor_x, int cursor_y,
+               unsigned int tone, unsigned int tone_ms, unsigned int duration_ms)
+{
+    struct AnimFrame *f;
+    unsigned int wp = anim_wp;
+
+    while(wp - anim_rp >= ANIM_QUEUE_SIZE)
+        ;
+
+    f = &anim_queue[wp & (ANIM_QUEUE_SIZE - 1)];
+
+    f->col         = (signed char)col;
+    f->cursor_x    = (signed char)cursor_x;
+    f->cursor_y    = (signed char)cursor_y;
+    f->rg_data     = rg_data;
+    f->tone        = (uint16_t)tone;
+    f->tone_ms     = (uint16_t)tone_ms;
+    f->duration_ms = (uint16_t)duration_ms;
+
+    anim_wp = wp + 1;
+}
+
+// 積んだアニメーションをすべて表示し終わったか
+int anim_is_idle(void)
+{
+    return (anim_rp == anim_wp) && !anim_remain_ms;
+}
+
+// 積んであるアニメーションを捨てる. 割込みが受け付けるまで待つ(1ms以内).
+void anim_cancel(void)
+{
+    anim_cancel_req = 1;
+
+    while(anim_cancel_req)
+        ;
+}
+
+// アニメーションを1ms進める. anim_timer のコールバック.
+// 時間0のフレームは同じ割込みで続けて表示する.
+void anim_tick(void)
+{
+    const struct AnimFrame *f;
+    int k;
+
+    if(anim_cancel_req)
+    {
+        anim_rp         = anim_wp;
+        anim_remain_ms  = 0;
+        anim_cancel_req = 0;
+        return;
+    }
+
+    if(anim_remain_ms) anim_remain_ms--;
+
+    while(!anim_remain_ms && (anim_rp != anim_wp))
+    {
+        f = &anim_queue[anim_rp & (ANIM_QUEUE_SIZE - 1)];
+
+        // 表示面と書き込み面の両方を書き換えるので, 面の切り替えがあっても消えない
+        if(f->col != ANIM_NO_CHANGE)
+        {
+            for(k = 0; k < BCM_PLANES; k++)
+            {
+                frame_buf[0][k][f->col] = f->rg_data;
+                frame_buf[1][k][f->col] = f->rg_data;
+            }
+        }
+
+        if(f->cursor_x != ANIM_NO_CHANGE)
+        {
+            cursor.x = f->cursor_x;
+            cursor.y = f->cursor_y;
+        }
+
+        if(f->tone)
+        {
+            melody_note_isr(f->tone, f->tone_ms);
+        }
+
+        anim_remain_ms = f->duration_ms;
+        anim_rp++;
+    }
+}
+/*****************************************************************************/
+
+
+/****************************** カーソル **************************************/
+// カーソルの座標をセット
+void set_cursor_xy(int x, int y)
+{
+    cursor.x = x;
+    cursor.y = y;
+}
+
+// カーソルの色をセット
+void set_cursor_color(enum stone_color sc)
+{
+    cursor.color = sc;
+}
+
+// 上下左右を指定してカーソルの座標を更新
+void move_cursor(enum Direction dir)
+{
+    int cx = cursor.x;
+    int cy = cursor.y;
+
+    if (dir == LEFT)  // 左
+    {
+        // 左シフト
+        cx--;
+
+        // 左端まで行ったら一つ上の行の右端にワープ
+        if (cx < 0)
+        {
+        	cx = MAT_WIDTH - 1;
+        	cy++;
+
+            // 上端を超えたら一番下の行にワープ
             if (cy > MAT_HEIGHT - 1)
             {
             	cy = 0;
@@ -687,14 +1369,6 @@ void move_cursor(enum Direction dir)
 
 
 /************************************ ゲームロジック *********************************/
-// タイミング調整
-void wait_10ms(int period)
-{
-    tc_10ms = 0;
-    while(tc_10ms < period)
-        nop();
-}
-
 // AD変換値を取得. 乱数のシード値に利用.
 unsigned int get_AD0_val(void)
 {
@@ -705,658 +1379,999 @@ unsigned int get_AD0_val(void)
     return (unsigned int)S12AD.ADDR0;
 }
 
-// 座標範囲外か
-int is_out_of_board(int x, int y)
+// コマを並べて結果発表. 盤面はすぐ最終形にし, 1コマずつ並べる様子はアニメーションキューに積む.
+void line_up_result(enum stone_color brd[][MAT_WIDTH], int stone1_count, int stone2_count, int period_ms, int buzzer_active)
 {
-    return ((x < 0) || (y < 0) || ( x > MAT_WIDTH  - 1) || (y > MAT_HEIGHT - 1));
+	int x, y;
+    uint16_t cols[MAT_WIDTH];
+
+    // コマを全撤去
+	for(x = 0; x < MAT_WIDTH; x++)
+	{
+		for(y = 0; y < MAT_HEIGHT; y++)
+        {
+            delete(brd, x, y);
+        }
+
+        cols[x] = 0x0000;
+        anim_push(x, 0x0000, ANIM_NO_CHANGE, ANIM_NO_CHANGE, 0, 0, 0);
+	}
+
+	x = 0;
+
+    // 最終結果をもとに再配置
+	while(stone1_count || stone2_count)
+	{
+        y = (MAT_WIDTH - 1) - (x / MAT_WIDTH);
+
+		if(stone1_count)
+		{
+            // 片方の色を左上から詰めていく
+            place(brd, x % MAT_WIDTH, y, stone_red);
+            cols[x % MAT_WIDTH] |= 1 << (y + 8);
+
+			stone1_count--;
+		}
+		else
+		{   // 詰め終わったら続きからもう片方の色を詰めていく
+			place(brd, x % MAT_WIDTH, y, stone_green);
+            cols[x % MAT_WIDTH] |= 1 << y;
+
+		    stone2_count--;
+		}
+
+        // x座標に合わせてドレミ, 詰めの間隔を調整
+        anim_push(x % MAT_WIDTH, cols[x % MAT_WIDTH], ANIM_NO_CHANGE, ANIM_NO_CHANGE,
+                  buzzer_active ? C_SCALE[x % MAT_WIDTH] : 0, 50, period_ms);
+
+		x++;
+	}
 }
 
-// 8方向のひっくり返しフラグを作る
-//　       右下  右上  左下  左上  右   左   下   上
-// flag :  b7    b6    b5    b4  b3   b2   b1   b0
-// bit  :  0..その方角にひっくり返せない, 1..その方角にひっくり返せる
-unsigned char make_flip_dir_flag(enum stone_color brd[][MAT_WIDTH], int x, int y, enum stone_color sc)
+/********************************************* AI ***********************************************/
+// AIの次の行き先を決める
+void set_AI_cursor_dest(enum stone_color brd[][MAT_WIDTH], enum stone_color sc, int placeable_count, int depth)
 {
-    int dir, i;
-    int dx, dy;
-    unsigned char flag = 0x00;
+    int i, best_idx, best_count;
+    int best_score;
+
+    // スキップ = どこにも置けない場合は現在のカーソル位置を返す
+    if(!placeable_count)
+    {
+        cursor.dest_x = cursor.x;
+        cursor.dest_y = cursor.y;
+        return;
+    }
+
+    // ミニマックス + αβ枝刈りで評価
+    minimax_alphabeta(brd, sc, depth);
 
-    enum stone_color search;
+    // 最高評価の手を見つける
+    best_score = -INF;
 
-    for(dir = 0; dir < 8; dir++)
+    for(i = 0; i < ai_move_counts[0]; i++)
     {
-        dx = dy = 0;
+        if(ai_moves[0][i].score > best_score)
+        {
+            best_score = ai_moves[0][i].score;
+        }
+    }
+
+    // 同じスコアの手の数をカウント
+    best_count = 0;
 
-        for(i = 0; i < 8; i++)
+    for(i = 0; i < ai_move_counts[0]; i++)
+    {
+        if(ai_moves[0][i].score == best_score)
         {
-            dx += DXDY[dir][0];
-            dy += DXDY[dir][1];
+            ai_entry_idx[best_count] = i;
+            best_count++;
+        }
+    }
 
-            // 範囲外ならbreak
-            if(is_out_of_board(x + dx, y + dy)) break;
+    // 同点の場合はランダムに選択
+    if(best_count > 1)
+    {
+        best_idx = ai_entry_idx[rand() % best_count];
+    }
+    else
+    {
+        best_idx = ai_entry_idx[0];
+    }
 
-            // コマの色を調査
-            search = read_stone_at(brd, x + dx, y + dy);
+    cursor.dest_x = ai_moves[0][best_idx].x;
+    cursor.dest_y = ai_moves[0][best_idx].y;
+}
 
-            // 何も置かれていなかったらbreak
-            if(search == stone_black) break;
+// カーソルが目的地まで1マスずつ動くアニメーションをキューに積む.
+// 縦横両方に動くときは斜めに1歩で進み, 音は縦の音になる.
+void push_AI_cursor_path(int buzzer_active)
+{
+    int x = cursor.x;
+    int y = cursor.y;
+    unsigned int tone;
 
-            // 挟む側のコマの色に遭遇
-            if(search == sc)
-            {
-                // i > 0 の時点で相手色を少なくとも1つは挟んでいる
-                if(i > 0)
-                {
-                    flag |= (1 << dir);
-                }
+    do
+    {
+        tone = 0;
 
-                break;
-            }
+        if(x < cursor.dest_x)
+        {
+            tone = C_SCALE[x];
+            x++;
+        }
+        else if(x > cursor.dest_x)
+        {
+            tone = C_SCALE[x];
+            x--;
+        }
+
+        if(y < cursor.dest_y)
+        {
+            tone = C_SCALE[y];
+            y++;
+        }
+        else if(y > cursor.dest_y)
+        {
+            tone = C_SCALE[y];
+            y--;
         }
+
+        anim_push(ANIM_NO_CHANGE, 0x0000, x, y, buzzer_active ? tone : 0, 100, AI_MOVE_PERIOD_MS);
     }
+    while((x != cursor.dest_x) || (y != cursor.dest_y));
+}
+/*************************************************************************************************/
+
 
-    return flag;
+/***************************************** 初期設定 ******************************************/
+
+// ためておく入力の初期化
+void init_PendingInput(struct PendingInput *in)
+{
+    in->decide = 0;
+    in->clicks = 0;
 }
 
-//その場所にその色は置けるか？
-int is_placeable(enum stone_color brd[][MAT_WIDTH], int x, int y, enum stone_color sc)
+// ゲーム情報初期化
+void init_Game(struct Game *g)
 {
-    unsigned char flag;
+	g->is_buzzer_active = 1; 
+	g->is_vs_AI         = 0;
+	g->is_AI_turn       = 0; 
+	g->is_skip          = 0;
+}
+
+// プレイヤー情報初期化
+void init_Player(struct Player *p1, struct Player *p2)
+{
+    // オセロのルール上最初は二か所しか置けない
+	p1->placeable_count = 2;
+	p2->placeable_count = 2;
+    p1->result          = 0;
+	p2->result          = 0;
+}
 
-    // 何かおいてあったらだめ
-    if(read_stone_at(brd, x, y) != stone_black) return 0;
+// 盤面を初期配置にする. 表示には触れない(棋譜の再生にも使う).
+void setup_board(enum stone_color brd[][MAT_WIDTH])
+{   int x, y;
 
-     // 8方向フラグ作成
-    flag = make_flip_dir_flag(brd, x, y, sc);
+    // コマ全撤去
+    for(x = 0;x < MAT_WIDTH; x++)
+    {
+        for(y = 0; y < MAT_HEIGHT; y++)
+        {
+            delete(brd, x, y);
+        }
+    }
 
-    // flag != 0x00なら少なくとも1方向は挟める
-    return (flag != 0x00);
+    // 真ん中に４つ置く
+    place(brd, 3, 3, stone_red);
+    place(brd, 4, 4, stone_red);
+    place(brd, 3, 4, stone_green);
+    place(brd, 4, 3, stone_green);
 }
 
-// 8方向フラグをつかって相手のコマをひっくり返す
-void flip_stones(unsigned char flag, enum stone_color brd[][MAT_WIDTH], int x, int y, enum stone_color sc)
+// 盤面初期化
+void init_board(enum stone_color brd[][MAT_WIDTH])
 {
-    int dir, i;
-    int dx, dy;
-    enum stone_color search;
+    setup_board(brd);
+    mark_board_dirty();
+}
 
-    for(dir = 0; dir < 8; dir++)
-    {
-        dx = dy = 0;
+// カーソル初期化
+void init_Cursor(void)
+{
+    set_cursor_color(stone_red);
+    set_cursor_xy(5, 3);
+}
 
-        if(flag & (1 << dir))
-        {
-            for(i = 0; i < 8; i++)
-            {
-                dx += DXDY[dir][0];
-                dy += DXDY[dir][1];
+// LCD表示初期化
+void init_lcd_show(enum stone_color sc)
+{
+	lcd_clear();
+	lcd_xy(5, 1);
+	lcd_puts("othello");
+	lcd_xy(1, 2);
+	lcd_puts("VS >FRIEND : AI");
+	flush_lcd();
+}
+/*************************************************************************************************/
 
-                // コマの色をチェック
-                search = read_stone_at(brd, x + dx, y + dy);
 
-                // 置きチェック済みなので確認するのは自分の色が出たかのみ
-                if(search == sc)
-                {
-                    break;
-                }
+/****************************************** 棋譜 ************************************************/
+// 今の局の棋譜. 0 = まだ始まっていない.
+struct GameRecord *record_current(void)
+{
+    if(!record_game_no) return 0;
 
-                // 新しくコマを置く
-                place(brd, x + dx, y + dy, (search == stone_red) ? stone_green : stone_red);
-            }
-        }
+    return &record_games[(record_game_no - 1) & (RECORD_GAMES - 1)];
+}
+
+// 対戦モードを棋譜のフラグにする
+unsigned char record_mode_flags(const struct Game *g)
+{
+    unsigned char flags = 0;
+
+    if(g->is_vs_AI)   flags |= RECORD_VS_AI;
+    if(g->is_AI_turn) flags |= RECORD_AI_FIRST;
+
+    return flags;
+}
+
+// 新しい局の棋譜を始める. INIT_GAME で init_Game の後に呼ぶ.
+void record_begin(unsigned int seed, const struct Game *g)
+{
+    struct GameRecord *r;
+
+    record_game_no++;
+
+    r = record_current();
+    r->start = record_wp;
+    r->seed  = (unsigned short)seed;
+    r->flags = record_mode_flags(g);
+    r->count = 0;
+}
+
+// 対戦モードが決まったら呼ぶ
+void record_set_mode(const struct Game *g)
+{
+    struct GameRecord *r = record_current();
+
+    if(r) r->flags = (r->flags & RECORD_DONE) | record_mode_flags(g);
+}
+
+// 中断局面から続ける局にする. record_begin の直後, 戻した盤面と手番で呼ぶ.
+// 戻した g->is_AI_turn は直前に打った側がAIかなので, 赤がAIかを求め直す.
+void record_mark_resumed(enum stone_color brd[][MAT_WIDTH], enum stone_color color, const struct Game *g)
+{
+    struct GameRecord *r = record_current();
+
+    if(!r) return;
+
+    r->flags = RECORD_RESUMED;
+    if(g->is_vs_AI)
+    {
+        r->flags |= RECORD_VS_AI;
+        if(g->is_AI_turn == (color == stone_green)) r->flags |= RECORD_AI_FIRST;
     }
+
+    r->start_color = (unsigned char)color;
+    pack_board(brd, &r->start_board);
 }
 
-// ボード上にその色のコマが置ける場所はあるか
-int count_placeable(enum stone_color brd[][MAT_WIDTH], enum stone_color sc)
+// 1手(RECORD_MOVE または RECORD_SKIP)を記録する
+void record_push(unsigned char move)
 {
-    int x, y;
-    int count = 0;
+    struct GameRecord *r = record_current();
 
-    for(x = 0; x < MAT_WIDTH; x++)
+    if(!r || (r->count >= RECORD_MAX_MOVES)) return;
+
+    record_moves[record_wp & (RECORD_BUF_SIZE - 1)] = move;
+    record_wp++;
+    r->count++;
+}
+
+// 局の手が上書きされずにリングに残っているか
+int record_is_valid(const struct GameRecord *r)
+{
+    return (record_wp - r->start) <= RECORD_BUF_SIZE;
+}
+
+// 局の手を moves に写す. 戻り値 : 手数
+int record_copy(const struct GameRecord *r, unsigned char *moves)
+{
+    int i;
+
+    for(i = 0; i < r->count; i++)
     {
-        for(y = 0; y < MAT_HEIGHT; y++)
-        {
-            if(is_placeable(brd, x, y, sc))
-            {
-                count++;
-            }
-        }
+        moves[i] = record_moves[(r->start + i) & (RECORD_BUF_SIZE - 1)];
     }
 
-    return count;
+    return r->count;
 }
 
-// 指定した色のコマの数を数える
-int count_stones(enum stone_color brd[][MAT_WIDTH], enum stone_color sc)
+// 最初(RECORD_RESUMED なら続けた局面)から ply 手目までを打った局面を作る. AIは動かさない.
+// 戻り値 : 次の手番の色. 棋譜に置けない手があれば stone_black.
+enum stone_color record_replay(const struct GameRecord *r, const unsigned char *moves, int ply, enum stone_color brd[][MAT_WIDTH])
 {
-    int x, y;
-    int count = 0;
+    enum stone_color color = stone_red;
+    int i, x, y;
 
-    for(x = 0; x < MAT_WIDTH; x++)
+    if(r->flags & RECORD_RESUMED)
     {
-        for(y = 0; y < MAT_HEIGHT; y++)
+        unpack_board(&r->start_board, brd);
+        color = (enum stone_color)r->start_color;
+    }
+    else
+    {
+        setup_board(brd);
+    }
+
+    for(i = 0; i < ply; i++)
+    {
+        if(moves[i] != RECORD_SKIP)
         {
-            if(read_stone_at(brd, x, y) == sc)
-            {
-                count++;
-            }
+            x = moves[i] % MAT_WIDTH;
+            y = moves[i] / MAT_WIDTH;
+
+            if((moves[i] >= MAT_WIDTH * MAT_HEIGHT) || !is_placeable(brd, x, y, color)) return stone_black;
+
+            place(brd, x, y, color);
+            flip_stones(make_flip_dir_flag(brd, x, y, color), brd, x, y, color);
         }
+
+        color = (color == stone_red) ? stone_green : stone_red;
     }
 
-    return count;
+    return color;
 }
 
-// どっちも置けなかったらおわり
-int is_game_over(int stone1_placeable_count, int stone2_placeable_count)
+// 1局を host/tune_eval の棋譜フォーマットで送る. コメント行に番号, シード, 対戦モード, 最後の局面のコマ数.
+// 最後まで打っていない局と, 中断局面から続けた局(初期局面から打っていない)は手の行もコメントにする(学習に使わない).
+// 続けた局は "# start" の行に最初の局面(y * 8 + x の順に R, G, -)と手番を送る.
+void record_send(unsigned int no, const struct GameRecord *r, const unsigned char *moves)
 {
-    return (!stone1_placeable_count && !stone2_placeable_count);
-}
+    enum stone_color brd[MAT_HEIGHT][MAT_WIDTH];
+    int i;
 
-// コマを並べて結果発表
-void line_up_result(enum stone_color brd[][MAT_WIDTH], int stone1_count, int stone2_count, int period_10ms, int *buzzer_active)
-{
-	int x, y;
+    sci_puts("# game ");
+    sci_put_ulong(no, 0);
+    sci_puts(" seed ");
+    sci_put_ulong(r->seed, 0);
+    sci_puts((r->flags & RECORD_VS_AI) ? ((r->flags & RECORD_AI_FIRST) ? " AI-human" : " human-AI") : " human-human");
+    if(r->flags & RECORD_RESUMED) sci_puts(" resumed");
 
-    // コマを全撤去
-	for(x = 0; x < MAT_WIDTH; x++)
-	{
-		for(y = 0; y < MAT_HEIGHT; y++)
+    if(record_replay(r, moves, r->count, brd) == stone_black)
+    {
+        sci_puts(" broken\r\n");
+        return;
+    }
+
+    sci_puts(" red ");
+    sci_put_ulong(count_stones(brd, stone_red), 0);
+    sci_puts(" green ");
+    sci_put_ulong(count_stones(brd, stone_green), 0);
+    if(!(r->flags & RECORD_DONE)) sci_puts(" unfinished");
+    sci_puts("\r\n");
+
+    if(r->flags & RECORD_RESUMED)
+    {
+        sci_puts("# start ");
+        unpack_board(&r->start_board, brd);
+        for(i = 0; i < MAT_HEIGHT * MAT_WIDTH; i++)
         {
-            delete(brd, x, y);
+            sci_putc("RG-"[brd[i / MAT_WIDTH][i % MAT_WIDTH]]);
         }
-	}
+        sci_puts((r->start_color == stone_red) ? " red\r\n" : " green\r\n");
+    }
 
-    flush_board(brd);
+    if((r->flags & (RECORD_DONE | RECORD_RESUMED)) != RECORD_DONE) sci_puts("# ");
 
-	x = 0;
+    for(i = 0; i < r->count; i++)
+    {
+        if(moves[i] == RECORD_SKIP)
+        {
+            sci_puts("--");
+        }
+        else
+        {
+            sci_putc((char)('0' + moves[i] % MAT_WIDTH));
+            sci_putc((char)('0' + moves[i] / MAT_WIDTH));
+        }
+    }
 
-    // 最終結果をもとに再配置
-	while(stone1_count || stone2_count)
-	{
-		if(stone1_count)
-		{
-            // 片方の色を左上から詰めていく
-            place(brd, x % MAT_WIDTH, ((MAT_WIDTH - 1) - (x / MAT_WIDTH)), stone_red);
+    sci_puts("\r\n");
+}
 
-			stone1_count--;
-		}
-		else
-		{   // 詰め終わったら続きからもう片方の色を詰めていく
-			place(brd, x % MAT_WIDTH, ((MAT_WIDTH - 1) - (x / MAT_WIDTH)), stone_green);
+// RAM に残っている局を古い順に送る
+void record_dump(void)
+{
+    unsigned char moves[RECORD_MAX_MOVES];
+    const struct GameRecord *r;
+    unsigned int no;
 
-		    stone2_count--;
-		}
+    sci_puts("# games since boot\r\n");
 
-        flush_board(brd);
+    for(no = (record_game_no > RECORD_GAMES) ? record_game_no - RECORD_GAMES + 1 : 1; no <= record_game_no; no++)
+    {
+        r = &record_games[(no - 1) & (RECORD_GAMES - 1)];
+        if(!record_is_valid(r)) continue;
 
-        // x座標に合わせてドレミ
-		beep(C_SCALE[x % MAT_WIDTH], 50, *buzzer_active);
+        record_copy(r, moves);
+        record_send(no, r, moves);
+    }
+}
 
-        // 詰めの感覚を調整
-		wait_10ms(period_10ms);
+#ifdef RECORD_FLASH
+// データフラッシュのブロックの棋譜を読む. 戻り値 : 1 = 有効な棋譜, 0 = 無い
+int record_df_read(unsigned int block, struct GameRecordHeader *h, unsigned char *moves)
+{
+    unsigned int offset = (RECORD_DF_FIRST_BLOCK + block) * DF_BLOCK_SIZE;
 
-		x++;
-	}
+    if(df_is_blank(RECORD_DF_FIRST_BLOCK + block)) return 0;
+
+    df_read(offset, h, sizeof(*h));
+    if((h->magic != RECORD_DF_MAGIC) || (h->count > DF_BLOCK_SIZE - sizeof(*h))) return 0;
+
+    if(moves) df_read(offset + sizeof(*h), moves, h->count);
+
+    return 1;
 }
 
-/********************************************* AI ***********************************************/
-// 盤面の位置評価を計算
-int evaluate_position_weight(enum stone_color brd[][MAT_WIDTH], enum stone_color ai_color)
+// データフラッシュを使えるようにし, 次に書く通し番号を探す. init_RX210 の後に呼ぶ.
+void record_flash_init(void)
 {
-    int x, y;
-    int ai_score = 0;
-    int opp_score = 0;
-    enum stone_color opp_color = (ai_color == stone_red) ? stone_green : stone_red;
+    struct GameRecordHeader h;
+    unsigned int block;
+    int found = 0;
 
-    for(y = 0; y < MAT_HEIGHT; y++)
+    record_df_ok = (df_init() == 0);
+    if(!record_df_ok) return;
+
+    record_df_seq = 0;
+
+    // 通し番号は16ビットで一周するので差で比べる
+    for(block = 0; block < RECORD_DF_BLOCKS; block++)
     {
-        for(x = 0; x < MAT_WIDTH; x++)
+        if(record_df_read(block, &h, 0) && (!found || ((int16_t)(h.seq - record_df_seq) >= 0)))
         {
-            if(read_stone_at(brd, x, y) == ai_color)
-            {
-                ai_score += POSITION_WEIGHTS[y][x];
-            }
-            else if(read_stone_at(brd, x, y) == opp_color)
-            {
-                opp_score += POSITION_WEIGHTS[y][x];
-            }
+            record_df_seq = h.seq + 1;
+            found = 1;
         }
     }
+}
 
-    return ai_score - opp_score;
+// 今の局をデータフラッシュに書く. 手, ヘッダの残り, magic の順に書くので, 途中で電源が切れた局は読まない.
+// ブロックの消去を待つので数ms かかる. 1ブロックに入らない局(スキップが続いて100手を超えた局)は書かない.
+void record_flash_save(void)
+{
+    struct GameRecordHeader h;
+    unsigned char moves[RECORD_MAX_MOVES + 1];      // 奇数手のときは 0 を足して2バイト単位にする
+    const struct GameRecord *r = record_current();
+    unsigned int block = record_df_seq % RECORD_DF_BLOCKS;
+    unsigned int offset = (RECORD_DF_FIRST_BLOCK + block) * DF_BLOCK_SIZE;
+    int bytes;
+
+    if(!record_df_ok || !r || !record_is_valid(r) || (r->count > DF_BLOCK_SIZE - sizeof(h))) return;
+
+    // 詰め物も 0 にして書く
+    memset(&h, 0, sizeof(h));
+    h.magic       = RECORD_DF_MAGIC;
+    h.seq         = (uint16_t)record_df_seq;
+    h.seed        = r->seed;
+    h.flags       = r->flags;
+    h.count       = r->count;
+    h.start_color = r->start_color;
+    h.start_board = r->start_board;
+
+    bytes = record_copy(r, moves);
+    moves[bytes] = 0;
+    bytes = (bytes + 1) & ~1;
+
+    if(df_erase(RECORD_DF_FIRST_BLOCK + block)) return;
+    if(df_write(offset + sizeof(h), moves, bytes)) return;
+    if(df_write(offset + sizeof(h.magic), (const unsigned char *)&h + sizeof(h.magic), sizeof(h) - sizeof(h.magic))) return;
+    if(df_write(offset, &h, sizeof(h.magic))) return;
+
+    record_df_seq++;
 }
 
-// コマの数の差を計算. 終盤用.
-int evaluate_stone_count(enum stone_color brd[][MAT_WIDTH], enum stone_color ai_color)
+// データフラッシュの局を古い順に送る
+void record_flash_dump(void)
 {
-    int x, y;
-    int ai_count = 0;
-    int opp_count = 0;
-    enum stone_color opp_color = (ai_color == stone_red) ? stone_green : stone_red;
+    unsigned char moves[DF_BLOCK_SIZE];
+    struct GameRecordHeader h;
+    struct GameRecord r;
+    unsigned int i;
 
-    for(y = 0; y < MAT_HEIGHT; y++)
+    sci_puts("# games in data flash\r\n");
+
+    if(!record_df_ok) return;
+
+    for(i = 0; i < RECORD_DF_BLOCKS; i++)
     {
-        for(x = 0; x < MAT_WIDTH; x++)
+        if(record_df_read((record_df_seq + i) % RECORD_DF_BLOCKS, &h, moves))
         {
-            if(read_stone_at(brd, x, y) == ai_color)
-            {
-                ai_count++;
-            }
-            else if(read_stone_at(brd, x, y) == opp_color)
-            {
-                opp_count++;
-            }
+            r.seed        = h.seed;
+            r.flags       = h.flags;
+            r.count       = h.count;
+            r.start_color = h.start_color;
+            r.start_board = h.start_board;
+            record_send(h.seq, &r, moves);
         }
     }
+}
+#endif
+
+// 今の局が最後まで打たれた. END_CALC で呼ぶ.
+void record_end(void)
+{
+    struct GameRecord *r = record_current();
+
+    if(!r) return;
+
+    r->flags |= RECORD_DONE;
+
+#ifdef RECORD_FLASH
+    record_flash_save();
+#endif
+}
+/*************************************************************************************************/
+
+
+/****************************************** 中断局面 ************************************************/
+#ifndef RESUME_NO_FLASH
+// 対局中の局面を残す. TURN_SWITCH で手番を替えた後に呼ぶ.
+void resume_save(enum stone_color brd[][MAT_WIDTH], const struct Game *g)
+{
+    struct ResumeSnapshot snap;
+
+    pack_board(brd, &snap.board);
+    snap.color    = (unsigned char)cursor.color;
+    snap.cursor   = (unsigned char)(cursor.y * MAT_WIDTH + cursor.x);
+    snap.flags    = RESUME_ACTIVE;
+
+    if(g->is_buzzer_active) snap.flags |= RESUME_BUZZER;
+    if(g->is_vs_AI)         snap.flags |= RESUME_VS_AI;
+    if(g->is_AI_turn)       snap.flags |= RESUME_AI_TURN;
+    if(g->is_skip)          snap.flags |= RESUME_SKIP;
 
-    return ai_count - opp_count;
+    resume_write(&snap);
 }
 
-// 絶対に取られないコマの数を計算
-int count_stable_stones(enum stone_color brd[][MAT_WIDTH], enum stone_color color)
+// 対局が終わった(やめた)ので, 起動しても続けないようにする. 対局中の局面が残っているときだけ書く.
+void resume_clear(void)
 {
-    int stable_count = 0;
+    struct ResumeSnapshot snap;
 
-    // 角のコマは確定石
-    if(read_stone_at(brd, 0,           0             ) == color) stable_count++;
-    if(read_stone_at(brd, MAT_WIDTH-1, 0             ) == color) stable_count++;
-    if(read_stone_at(brd, 0,           MAT_HEIGHT - 1) == color) stable_count++;
-    if(read_stone_at(brd, MAT_WIDTH-1, MAT_HEIGHT - 1) == color) stable_count++;
+    if(!resume_active) return;
 
-    return stable_count;
+    memset(&snap, 0, sizeof(snap));
+    resume_write(&snap);
 }
 
-// 盤面を評価する関数. AI視点でのスコア.
-int evaluate_board(enum stone_color brd[][MAT_WIDTH], enum stone_color ai_color)
+// 起動して最初の INIT_GAME で呼ぶ. 対局中の局面が残っていれば盤面, ゲームの状態, カーソルを戻す.
+// 戻り値 : 1 = 戻した (TURN_COUNT から続ける), 0 = 新しい局
+int resume_restore(enum stone_color brd[][MAT_WIDTH], struct Game *g)
 {
-    enum stone_color opp_color = (ai_color == stone_red) ? stone_green : stone_red;
-    int position_score, mobility_score, stable_score;
-    int ai_stable, opp_stable;
+    if(resume_tried) return 0;
+    resume_tried = 1;
 
-    // 位置評価
-    position_score = evaluate_position_weight(brd, ai_color);
+    if(!resume_active) return 0;
 
-    // 配置可能数評価. 相手の手数が少ないほど有利.
-    mobility_score = -count_placeable(brd, opp_color);
+    unpack_board(&resume_last.board, brd);
 
-    // 確定石評価
-    ai_stable = count_stable_stones(brd, ai_color);
-    opp_stable = count_stable_stones(brd, opp_color);
-    stable_score = (ai_stable - opp_stable) * STABLE_WEIGHT;
+    g->is_buzzer_active = (resume_last.flags & RESUME_BUZZER)  != 0;
+    g->is_vs_AI         = (resume_last.flags & RESUME_VS_AI)   != 0;
+    g->is_AI_turn       = (resume_last.flags & RESUME_AI_TURN) != 0;
+    g->is_skip          = (resume_last.flags & RESUME_SKIP)    != 0;
 
-    return position_score * POS_WEIGHT + mobility_score * MOBILITY_WEIGHT + stable_score;
+    set_cursor_color((enum stone_color)resume_last.color);
+    set_cursor_xy(resume_last.cursor % MAT_WIDTH, resume_last.cursor / MAT_WIDTH);
+
+    mark_board_dirty();
+
+    return 1;
 }
+#endif
+/*************************************************************************************************/
 
-// ミニマックス法 + αβ枝刈り
-int minimax_alphabeta(enum stone_color brd[][MAT_WIDTH], enum stone_color ai_color, int max_depth)
+
+/****************************************** 状態プロファイラ ************************************************/
+#ifdef STATE_PROFILE
+// 状態の名前 (enum State の順)
+static const char *const STATE_NAME[STATE_COUNT] =
 {
-    int depth, x, y, i, move_idx;
-    enum stone_color current_color;
-    int score, best_score;
-    int is_max_player;
+    "INIT_HW", "INIT_GAME", "SELECT_VS", "SELECT_WAIT", "TURN_START", "TURN_CHECK", "AI_THINK",
+    "INPUT_WAIT", "INPUT_READ", "AI_MOVE", "PLACE_CHECK", "PLACE_OK", "PLACE_NG", "FLIP_CALC", "FLIP_RUN",
+    "TURN_SWITCH", "TURN_COUNT", "TURN_JUDGE", "TURN_SHOW", "END_CALC", "END_SHOW", "END_LINE_UP",
+    "END_RESULT", "END_WAIT", "END_RESET"
+};
 
-    // スタック用の変数
-    int stack_alpha[AI_DEPTH + 1];
-    int stack_beta[AI_DEPTH + 1];
-    int stack_best_score[AI_DEPTH + 1];
-    int stack_move_idx[AI_DEPTH + 1];
-    int stack_is_max[AI_DEPTH + 1];
+// 滞在時間と遷移の履歴を消す. 今の状態には今入ったことにする.
+void prof_reset(void)
+{
+    int i;
 
-    // 初期化
-    memcpy(ai_buf[0], brd, sizeof(enum stone_color) * MAT_HEIGHT * MAT_WIDTH);
+    for(i = 0; i < STATE_COUNT; i++)
+    {
+        prof_stat[i].count    = 0;
+        prof_stat[i].min_us   = 0xFFFFFFFFUL;
+        prof_stat[i].max_us   = 0;
+        prof_stat[i].total_us = 0;
+    }
 
-    // ルートノードの候補手を生成
-    ai_move_counts[0] = 0;
-    for(y = 0; y < MAT_HEIGHT; y++)
+    prof_trace_wp = 0;
+    prof_enter_us = boot_now_us();
+}
+
+// 状態の遷移を記録する. from の滞在時間を集計し, 遷移の履歴に積む.
+void prof_transition(enum State from, enum State to)
+{
+    unsigned long now = boot_now_us();
+    unsigned long dwell = now - prof_enter_us;
+    struct StateStat *st = &prof_stat[from];
+    struct StateTrace *a, *b;
+    unsigned int n = prof_trace_wp;
+
+    st->count++;
+    st->total_us += dwell;
+    if(dwell < st->min_us) st->min_us = dwell;
+    if(dwell > st->max_us) st->max_us = dwell;
+
+    prof_enter_us = now;
+
+    // 2つの状態の往復(入力待ちなど)は履歴を埋めないように回数だけ数える
+    if(n >= 2)
     {
-        for(x = 0; x < MAT_WIDTH; x++)
+        a = &prof_trace[(n - 2) & (PROF_TRACE_SIZE - 1)];
+        b = &prof_trace[(n - 1) & (PROF_TRACE_SIZE - 1)];
+
+        if((a->from == b->to) && (a->to == b->from))
         {
-            if(is_placeable(ai_buf[0], x, y, ai_color))
-            {
-                ai_moves[0][ai_move_counts[0]].x = x;
-                ai_moves[0][ai_move_counts[0]].y = y;
-                ai_moves[0][ai_move_counts[0]].score = -INF;
-                ai_move_counts[0]++;
-            }
+            if((a->from == from) && (a->to == to)) { a->repeat++; return; }
+            if((b->from == from) && (b->to == to)) { b->repeat++; return; }
         }
     }
 
-    if(ai_move_counts[0] == 0) return -INF;
+    a = &prof_trace[n & (PROF_TRACE_SIZE - 1)];
+    a->time_us = now;
+    a->from    = (unsigned char)from;
+    a->to      = (unsigned char)to;
+    a->repeat  = 0;
 
-    best_score = -INF;
+    prof_trace_wp = n + 1;
+}
 
-    // 各候補手を評価
-    for(i = 0; i < ai_move_counts[0]; i++)
+// 滞在時間と遷移の履歴を SCI1 に送る. 送っている間も今の状態の滞在時間に入る.
+void prof_dump(void)
+{
+    const struct StateStat *st;
+    const struct StateTrace *t;
+    unsigned int i, n = prof_trace_wp;
+
+    sci_puts("# state dwell [us]\r\n");
+    sci_puts("# state           count        min        avg        max\r\n");
+
+    for(i = 0; i < STATE_COUNT; i++)
     {
-        x = ai_moves[0][i].x;
-        y = ai_moves[0][i].y;
+        st = &prof_stat[i];
+        if(!st->count) continue;
+
+        sci_puts(STATE_NAME[i]);
+        sci_put_ulong(st->count, 20 - (int)strlen(STATE_NAME[i]));
+        sci_put_ulong(st->min_us, 11);
+        sci_put_ulong((unsigned long)(st->total_us / st->count), 11);
+        sci_put_ulong(st->max_us, 11);
+        sci_puts("\r\n");
+    }
+
+    sci_puts("# transitions : time [us] from -> to (repeats)\r\n");
 
-        // 手を打つ
-        memcpy(ai_buf[1], ai_buf[0], sizeof(enum stone_color) * MAT_HEIGHT * MAT_WIDTH);
-        flip_stones(make_flip_dir_flag(ai_buf[1], x, y, ai_color), ai_buf[1], x, y, ai_color);
+    for(i = (n > PROF_TRACE_SIZE) ? n - PROF_TRACE_SIZE : 0; i < n; i++)
+    {
+        t = &prof_trace[i & (PROF_TRACE_SIZE - 1)];
 
-        // 深さ1から探索開始
-        depth = 1;
-        stack_alpha[1] = -INF;
-        stack_beta[1] = INF;
-        stack_move_idx[1] = 0;
-        stack_is_max[1] = 0;  // 次は相手のターン
-        score = -INF;
+        sci_put_ulong(t->time_us, 11);
+        sci_putc(' ');
+        sci_puts(STATE_NAME[t->from]);
+        sci_puts(" -> ");
+        sci_puts(STATE_NAME[t->to]);
 
-        while(depth > 0)
+        if(t->repeat)
         {
-            if(depth >= max_depth)
-            {
-                // 葉ノード：評価値を計算
-                score = evaluate_board(ai_buf[depth], ai_color);
-                depth--;
+            sci_puts(" x");
+            sci_put_ulong(t->repeat + 1UL, 0);
+        }
 
-                if(depth > 0)
-                {
-                    if(stack_is_max[depth])
-                    {
-                        if(score > stack_best_score[depth])
-                            stack_best_score[depth] = score;
-
-                        if(stack_best_score[depth] >= stack_beta[depth])
-                        {
-                            // β枝刈り
-                            score = stack_best_score[depth];
-                            depth--;
-                            if(depth > 0)
-                            {
-                                stack_move_idx[depth]++;
-                            }
-                            continue;
-                        }
-
-                        if(stack_best_score[depth] > stack_alpha[depth])
-                            stack_alpha[depth] = stack_best_score[depth];
-                    }
-                    else
-                    {
-                        if(score < stack_best_score[depth])
-                            stack_best_score[depth] = score;
-
-                        if(stack_best_score[depth] <= stack_alpha[depth])
-                        {
-                            // α枝刈り
-                            score = stack_best_score[depth];
-                            depth--;
-                            if(depth > 0)
-                            {
-                                stack_move_idx[depth]++;
-                            }
-                            continue;
-                        }
-
-                        if(stack_best_score[depth] < stack_beta[depth])
-                            stack_beta[depth] = stack_best_score[depth];
+        sci_puts("\r\n");
+    }
+}
+#endif
+/*************************************************************************************************/
 
-                    }
-                    stack_move_idx[depth]++;
-                }
-                continue;
-            }
 
-            // 現在のプレイヤー
-            is_max_player = stack_is_max[depth];
-            current_color = (depth % 2 == 1) ? (ai_color == stone_red ? stone_green : stone_red) : ai_color;
+/****************************************** 割込みプロファイラ ************************************************/
+#ifdef ISR_PROFILE
+// 割込みの名前 (enum IsrVector の順)
+static const char *const ISR_NAME[ISR_VECTORS] = {"CMT0", "CMT1", "RSPI0", "IRQ0", "IRQ1", "SCI1_TXI"};
 
-            // 初回訪問時：候補手を生成
-            if(stack_move_idx[depth] == 0)
-            {
-                ai_move_counts[depth] = 0;
-                for(y = 0; y < MAT_HEIGHT; y++)
-                {
-                    for(x = 0; x < MAT_WIDTH; x++)
-                    {
-                        if(is_placeable(ai_buf[depth], x, y, current_color))
-                        {
-                            ai_moves[depth][ai_move_counts[depth]].x = x;
-                            ai_moves[depth][ai_move_counts[depth]].y = y;
-                            ai_move_counts[depth]++;
-                        }
-                    }
-                }
+// 値が入るヒストグラムのビン (値のビット数)
+int isr_hist_bin(unsigned int value)
+{
+    int bin = 0;
 
-                // 手がない場合
-                if(ai_move_counts[depth] == 0)
-                {
-                    // パス：評価値を返す
-                    score = evaluate_board(ai_buf[depth], ai_color);
-                    depth--;
+    while(value)
+    {
+        value >>= 1;
+        bin++;
+    }
 
-                    if(depth > 0)
-                    {
-                        if(stack_is_max[depth])
-                        {
-                            if(score > stack_best_score[depth])
-                                stack_best_score[depth] = score;
-
-                        }
-                        else
-                        {
-                            if(score < stack_best_score[depth])
-                                stack_best_score[depth] = score;
-                        }
-
-                        stack_move_idx[depth]++;
-                    }
-                    continue;
-                }
+    return bin;
+}
 
-                stack_best_score[depth] = is_max_player ? -INF : INF;
-            }
+// 割込みの入口で呼ぶ. latency はタイマ割込みならそのタイマの CMCNT (コンペアマッチからの経過), 計れなければ ISR_NO_LATENCY.
+void isr_enter(enum IsrVector v, unsigned int latency)
+{
+    volatile struct IsrStat *st = &isr_stat[v];
 
-            // すべての手を評価済み
-            if(stack_move_idx[depth] >= ai_move_counts[depth])
-            {
-                score = stack_best_score[depth];
-                depth--;
+    st->start = CMT3.CMCNT;
 
-                if(depth > 0)
-                {
-                    if(stack_is_max[depth])
-                    {
-                        if(score > stack_best_score[depth])
-                            stack_best_score[depth] = score;
-
-                        if(stack_best_score[depth] >= stack_beta[depth])
-                        {
-                            // β枝刈り
-                            score = stack_best_score[depth];
-                            depth--;
-                            if(depth > 0)
-                            {
-                                stack_move_idx[depth]++;
-                            }
-                            continue;
-                        }
-
-                        if(stack_best_score[depth] > stack_alpha[depth])
-                            stack_alpha[depth] = stack_best_score[depth];
-                    }
-                    else
-                    {
-                        if(score < stack_best_score[depth])
-                            stack_best_score[depth] = score;
-
-                        if(stack_best_score[depth] <= stack_alpha[depth])
-                        {
-                            // α枝刈り
-                            score = stack_best_score[depth];
-                            depth--;
-                            if(depth > 0)
-                            {
-                                stack_move_idx[depth]++;
-                            }
-                            continue;
-                        }
-
-                        if(stack_best_score[depth] < stack_beta[depth])
-                            stack_beta[depth] = stack_best_score[depth];
-                    }
+    if(latency == ISR_NO_LATENCY) return;
 
-                    stack_move_idx[depth]++;
-                }
-                continue;
-            }
+    st->lat_hist[isr_hist_bin(latency)]++;
+    if(latency > st->max_latency) st->max_latency = latency;
+}
 
-            // 次の手を試す
-            move_idx = stack_move_idx[depth];
-            x = ai_moves[depth][move_idx].x;
-            y = ai_moves[depth][move_idx].y;
-
-            // 手を打つ
-            memcpy(ai_buf[depth + 1], ai_buf[depth], sizeof(enum stone_color) * MAT_HEIGHT * MAT_WIDTH);
-            flip_stones(make_flip_dir_flag(ai_buf[depth + 1], x, y, current_color), ai_buf[depth + 1], x, y, current_color);
-
-            // 次の深さへ
-            depth++;
-            stack_alpha[depth] = stack_alpha[depth - 1];
-            stack_beta[depth] = stack_beta[depth - 1];
-            stack_move_idx[depth] = 0;
-            stack_is_max[depth] = !is_max_player;
-        }
+// 割込みの出口で呼ぶ. isr_exit 自身の処理時間の一部も含む.
+void isr_exit(enum IsrVector v)
+{
+    volatile struct IsrStat *st = &isr_stat[v];
+    unsigned int t = (unsigned int)(CMT3.CMCNT - st->start) & 0xFFFF;
 
-        ai_moves[0][i].score = score;
-        if(score > best_score)
+    st->count++;
+    st->busy_counts += t;
+    st->dur_hist[isr_hist_bin(t)]++;
+    if(t > st->max_counts) st->max_counts = t;
+}
+
+// 割込みごとのCPU負荷を更新する. scan_load_update から1秒ごとに呼ぶ.
+void isr_load_update(void)
+{
+    int v;
+
+    for(v = 0; v < ISR_VECTORS; v++)
+    {
+        isr_load_permille[v] = isr_stat[v].busy_counts / CMT_COUNTS_PER_MS;
+        isr_stat[v].busy_counts = 0;
+    }
+}
+
+// 計測値を消す
+void isr_prof_reset(void)
+{
+    int v, k;
+
+    for(v = 0; v < ISR_VECTORS; v++)
+    {
+        clrpsw_i();
+
+        isr_stat[v].count       = 0;
+        isr_stat[v].max_counts  = 0;
+        isr_stat[v].max_latency = 0;
+
+        for(k = 0; k < ISR_HIST_BINS; k++)
         {
-            best_score = score;
+            isr_stat[v].dur_hist[k] = 0;
+            isr_stat[v].lat_hist[k] = 0;
         }
-    }
 
-    return best_score;
+        setpsw_i();
+    }
 }
 
-// AIの次の行き先を決める
-void set_AI_cursor_dest(enum stone_color brd[][MAT_WIDTH], enum stone_color sc, int placeable_count, int depth)
+// ヒストグラムを1行送る
+void isr_dump_hist(const char *name, const char *kind, const unsigned long *hist)
 {
-    int i, best_idx, best_count;
-    int best_score;
+    int k;
 
-    // スキップ = どこにも置けない場合は現在のカーソル位置を返す
-    if(!placeable_count)
+    sci_puts(name);
+    sci_puts(kind);
+
+    for(k = (int)(strlen(name) + strlen(kind)); k < 15; k++)
     {
-        cursor.dest_x = cursor.x;
-        cursor.dest_y = cursor.y;
-        return;
+        sci_putc(' ');
     }
 
-    // ミニマックス + αβ枝刈りで評価
-    minimax_alphabeta(brd, sc, depth);
-
-    // 最高評価の手を見つける
-    best_score = -INF;
-
-    for(i = 0; i < ai_move_counts[0]; i++)
+    for(k = 0; k < ISR_HIST_BINS; k++)
     {
-        if(ai_moves[0][i].score > best_score)
-        {
-            best_score = ai_moves[0][i].score;
-        }
+        sci_put_ulong(hist[k], 8);
     }
 
-    // 同じスコアの手の数をカウント
-    best_count = 0;
+    sci_puts("\r\n");
+}
 
-    for(i = 0; i < ai_move_counts[0]; i++)
+// 割込みごとの回数, 最悪値, 負荷とヒストグラムを SCI1 に送る. 割込みごとに割込み禁止で写してから送る.
+void isr_dump(void)
+{
+    struct IsrStat st;
+    int v, k;
+
+    sci_puts("# isr            count  max[cnt]  lat max[cnt]  load[0.1%]  (1 cnt = 0.32us)\r\n");
+
+    for(v = 0; v < ISR_VECTORS; v++)
     {
-        if(ai_moves[0][i].score == best_score)
-        {
-            ai_entry_idx[best_count] = i;
-            best_count++;
-        }
+        clrpsw_i();
+        st = *(struct IsrStat *)&isr_stat[v];
+        setpsw_i();
+
+        if(!st.count) continue;
+
+        sci_puts(ISR_NAME[v]);
+        sci_put_ulong(st.count, 22 - (int)strlen(ISR_NAME[v]));
+        sci_put_ulong(st.max_counts, 10);
+        sci_put_ulong(st.max_latency, 14);
+        sci_put_ulong(isr_load_permille[v], 12);
+        sci_puts("\r\n");
     }
 
-    // 同点の場合はランダムに選択
-    if(best_count > 1)
+    // ビンの上限 (この値未満)
+    sci_puts("# hist [cnt] < ");
+    for(k = 0; k < ISR_HIST_BINS; k++)
     {
-        best_idx = ai_entry_idx[rand() % best_count];
+        sci_put_ulong(1UL << k, 8);
     }
-    else
+    sci_puts("\r\n");
+
+    for(v = 0; v < ISR_VECTORS; v++)
     {
-        best_idx = ai_entry_idx[0];
-    }
+        clrpsw_i();
+        st = *(struct IsrStat *)&isr_stat[v];
+        setpsw_i();
 
-    cursor.dest_x = ai_moves[0][best_idx].x;
-    cursor.dest_y = ai_moves[0][best_idx].y;
+        if(!st.count) continue;
+
+        isr_dump_hist(ISR_NAME[v], " dur", st.dur_hist);
+        isr_dump_hist(ISR_NAME[v], " lat", st.lat_hist);
+    }
 }
+#endif
 /*************************************************************************************************/
 
 
-/***************************************** 初期設定 ******************************************/
-// 位相計数用レジスタのカウント数初期化
-void clear_pulse_diff_cnt(void)
+/****************************************** スタック ************************************************/
+#ifdef STACK_CHECK
+// top から end の手前までを STACK_PAINT で塗る. 今使っているスタックなら今の位置より下だけ塗る.
+void stack_paint_area(void *top, void *end)
 {
-    MTU1.TCNT = 0;
+    volatile unsigned long here;  // 今のスタックの位置
+    unsigned long *p     = (unsigned long *)top;
+    unsigned long *limit = (unsigned long *)end;
+
+    if(((unsigned long *)&here >= p) && ((unsigned long *)&here < limit))
+    {
+        limit = (unsigned long *)&here - STACK_PAINT_MARGIN;
+    }
+
+    while(p < limit)
+    {
+        *p++ = STACK_PAINT;
+    }
 }
 
-// ロータリーエンコーダー情報初期化
-void init_Rotary(struct Rotary *r)
+// ユーザスタックと割込みスタックを塗る. main の最初, 割込みを許可する前に呼ぶ.
+void stack_paint(void)
 {
-    r->current_cnt = 0;
-    r->prev_cnt    = 0;
+    stack_paint_area(__sectop("SU"), __secend("SU"));
+    stack_paint_area(__sectop("SI"), __secend("SI"));
 }
 
-// ゲーム情報初期化
-void init_Game(struct Game *g)
+// スタックの最大使用量[byte]. スタックは end から top に向かって伸びるので, top から塗ったままの語を数える.
+unsigned long stack_high_water(const void *top, const void *end)
 {
-	g->count_to_reset   = 0;
-	g->is_buzzer_active = 1; 
-	g->is_vs_AI         = 0;
-	g->is_AI_turn       = 0; 
-	g->is_skip          = 0;
+    const unsigned long *p = (const unsigned long *)top;
+
+    while((p < (const unsigned long *)end) && (*p == STACK_PAINT))
+    {
+        p++;
+    }
+
+    return (unsigned long)((const char *)end - (const char *)p);
 }
 
-// プレイヤー情報初期化
-void init_Player(struct Player *p1, struct Player *p2)
+// 名前と大きさを送る. 行末は送らない.
+void stack_dump_size(const char *name, unsigned long size)
 {
-    // オセロのルール上最初は二か所しか置けない
-	p1->placeable_count = 2;
-	p2->placeable_count = 2;
-    p1->result          = 0;
-	p2->result          = 0;
+    sci_puts(name);
+    sci_put_ulong(size, 20 - (int)strlen(name));
 }
 
-// 盤面初期化
-void init_board(enum stone_color brd[][MAT_WIDTH])
-{   int x, y;
+// スタックの大きさと最大使用量, AI用バッファの大きさを SCI1 に送る
+void stack_dump(void)
+{
+    char *su_top = __sectop("SU"), *su_end = __secend("SU");
+    char *si_top = __sectop("SI"), *si_end = __secend("SI");
+
+    sci_puts("# stack [byte]      size      used\r\n");
+    stack_dump_size("SU", su_end - su_top);
+    sci_put_ulong(stack_high_water(su_top, su_end), 10);
+    sci_puts("\r\n");
+    stack_dump_size("SI", si_end - si_top);
+    sci_put_ulong(stack_high_water(si_top, si_end), 10);
+    sci_puts("\r\n");
+
+    sci_puts("# AI_DEPTH ");
+    sci_put_ulong(AI_DEPTH, 0);
+    sci_puts(" [byte]\r\n");
+    stack_dump_size("ai_buf", AI_BUF_BYTES(AI_DEPTH));
+    sci_puts("\r\n");
+    stack_dump_size("ai_moves", AI_MOVES_BYTES(AI_DEPTH));
+    sci_puts("\r\n");
+    stack_dump_size("ai_move_counts", AI_MOVE_COUNTS_BYTES(AI_DEPTH));
+    sci_puts("\r\n");
+    stack_dump_size("eval_cache", EVAL_CACHE_BYTES);
+    sci_puts("\r\n");
+    stack_dump_size("stack_* (SU)", AI_STACK_BYTES(AI_DEPTH));
+    sci_puts("\r\n");
+}
+#endif
+/*************************************************************************************************/
 
-    // コマ全撤去
-    for(x = 0;x < MAT_WIDTH; x++)
+
+/****************************************** アイドル ************************************************/
+// 割込みが来るまでメインループにすることが無い状態か. 割込み禁止で呼ぶ.
+int is_idle_state(enum State state, const struct PendingInput *in)
+{
+    // 取り出していない入力イベントがある
+    if(input_rp != input_wp) return 0;
+
+    switch(state)
     {
-        for(y = 0; y < MAT_HEIGHT; y++)
-        {
-            delete(brd, x, y);
-        }
+        // 入力待ち
+        case SELECT_WAIT:
+        case SELECT_VS:
+        case INPUT_WAIT:
+        case INPUT_READ:
+        case END_WAIT:
+            return !in->decide && !in->clicks;
+
+        // アニメーション待ち
+        case AI_MOVE:
+        case END_LINE_UP:
+            return !anim_is_idle();
+
+        // 時間切れ待ち
+        case END_RESULT:
+            return !tw_fired(&state_timer);
+
+        default:
+            return 0;
     }
-
-    // 真ん中に４つ置く
-    place(brd, 3, 3, stone_red);
-    place(brd, 4, 4, stone_red);
-    place(brd, 3, 4, stone_green);
-    place(brd, 4, 3, stone_green);
 }
 
-// カーソル初期化
-void init_Cursor(void)
+// することが無ければ次の割込みまでCPUを止める. CMT0 が1msごとに起こすので, 止まるのは最長1ms.
+// 判定から wait() までは割込み禁止にするので, その間に来た割込みでもすぐ起きる.
+void idle_sleep(enum State state, const struct PendingInput *in)
 {
-    set_cursor_color(stone_red);
-    set_cursor_xy(5, 3);
-}
+#ifndef IDLE_NO_SLEEP
+    unsigned int start;
 
-// LCD表示初期化
-void init_lcd_show(enum stone_color sc)
-{
-	lcd_clear();
-	lcd_xy(5, 1);
-	lcd_puts("othello");
-	lcd_xy(1, 2);
-	lcd_puts("VS >FRIEND : AI");
-	flush_lcd();
+    clrpsw_i();
+
+    if(is_idle_state(state, in))
+    {
+        // 止まっていた時間は LCD の CMT3 (フリーラン, PCLKB/8) で計る. 起こした割込みの処理時間も含む.
+        start = CMT3.CMCNT;
+
+        wait();  // 割込み許可してスリープ. 割込みを処理してから戻る.
+
+        clrpsw_i();
+        idle_sleep_counts += (unsigned int)(CMT3.CMCNT - start) & 0xFFFF;
+    }
+
+    setpsw_i();
+#endif
 }
 /*************************************************************************************************/
 
@@ -1365,91 +2380,140 @@ void init_lcd_show(enum stone_color sc)
 // CMT0 CMI0 1msタイマ割込み
 void Excep_CMT0_CMI0(void)
 {
+    ISR_ENTER(ISR_CMT0, CMT0.CMCNT);
+
 	tc_1ms++;
 
-	beep_period_ms--;
+    // アニメーション, 入力イベント, LCD送信, メロディの音符の終わりなどはソフトウェアタイマで呼ぶ
+    tw_tick();
 
-    // 指定時間たったら音を止める
-	if(!beep_period_ms)
-	{
-		MTU.TSTR.BIT.CST0 = 0;
-	}
+    ISR_EXIT(ISR_CMT0);
 }
 
-// CMT1 CMI1 2msタイマ割込み
-void Excep_CMT1_CMI1(void)
+// 列スキャンのCPU負荷とスリープの割合を更新. 1秒間の時間[ms]がそのまま0.1%単位になる. scan_load_timer のコールバック.
+void scan_load_update(void)
 {
-	int x, y;
-    unsigned int rg_data = 0x0000;
+    scan_load_permille = scan_busy_counts / CMT_COUNTS_PER_MS;
+    scan_busy_counts = 0;
 
-    tc_2ms++;
+    idle_sleep_permille = idle_sleep_counts / CMT_COUNTS_PER_MS;
+    idle_sleep_counts = 0;
 
-	x = tc_2ms % MAT_WIDTH;
+#ifdef ISR_PROFILE
+    isr_load_update();
+#endif
+}
 
-    for(y = 0; y < MAT_HEIGHT; y++)
-    {
-        if(screen[y][x] == stone_red)
-        {
-            rg_data |= (1 << (y + 8));
-        }
-        else if(screen[y][x] == stone_green)
-        {
-            rg_data |= (1 << y);
-        }
-    }
+// 列スキャン割込みの処理時間を積算し, 最大値を記録する. start は割込みの入口での CMT1.CMCNT.
+// 割込みの受付と復帰の時間は含まないので, 実際の負荷は少し大きい.
+void scan_measure(unsigned int start)
+{
+    unsigned int t = (unsigned int)(CMT1.CMCNT - start) & 0xFFFF;
 
-    if((x != cursor.x) || (cursor.color == stone_black))
-    {
-        // マトリックスLED出力
-        col_out(x, rg_data);
+    scan_busy_counts += t;
 
-        return;
-    }
+    if(t > scan_isr_max_counts) scan_isr_max_counts = t;
+}
 
-    // 一定間隔でカーソルを点滅させる
-    if((tc_2ms / (CURSOR_BLINK_PERIOD_MS / 2)) % 2)
+// CMT1 CMI1 列スキャン割込み
+// 1列ごとにビットプレーンの数だけ割り込み, 点灯時間を区切るときは消灯でもう1回割り込む.
+// MATRIX_OUT_RSPI のときは DTC が起動するのでCPUには割り込まない
+void Excep_CMT1_CMI1(void)
+{
+#ifndef MATRIX_OUT_RSPI
+    unsigned int start = CMT1.CMCNT;
+	int plane = scan_phase;
+
+    ISR_ENTER(ISR_CMT1, start);
+
+#if SCAN_ON_TIME_PCT < 100
+    // 点灯時間が終わったら消灯し, 次の列までの残りを待つ
+    if(plane == BCM_PLANES)
     {
-        rg_data |= (cursor.color == stone_red) ? (1 << (cursor.y + 8)) : (1 << cursor.y);
+        COL_EN = 0;
+        CMT1.CMCOR = (SCAN_COL_COUNTS - SCAN_ON_COUNTS) - 1;
+        scan_phase = 0;
+        scan_measure(start);
+        ISR_EXIT(ISR_CMT1);
+        return;
     }
-    else if(rg_data & ((1 << (cursor.y + 8)) | (1 << cursor.y)))
+#endif
+
+    // 列の先頭で次の列に進む
+    if(plane == 0)
     {
-        rg_data &= ~((1 << (cursor.y + 8)) | (1 << cursor.y));
+        tc_scan++;
+
+        scan_col = tc_scan % MAT_WIDTH;
     }
 
+    // このビットプレーンを表示する時間
+    CMT1.CMCOR = BCM_PLANE_COUNTS(plane) - 1;
+
     //マトリックスLED出力
-    col_out(x, rg_data);
+    col_out(scan_col, scan_col_data(scan_col, plane));
+
+    scan_phase = plane + 1;
+
+#if SCAN_ON_TIME_PCT >= 100
+    if(scan_phase == BCM_PLANES) scan_phase = 0;
+#endif
+
+    scan_measure(start);
+    ISR_EXIT(ISR_CMT1);
+#endif
 }
 
-// CMT2 CMI2 10msタイマ割込み
-void Excep_CMT2_CMI2(void)
+#ifdef MATRIX_OUT_RSPI
+// RSPI0 SPRI0 1列の転送完了割込み (SCAN_COL_PERIOD_US 周期)
+void Excep_RSPI0_SPRI0(void)
 {
-	tc_10ms++;
+    unsigned int start = CMT1.CMCNT;
+    int x;
+
+    // 転送の完了は CMT1 のコンペアマッチから DTC の転送時間だけ遅れるので, 入口の遅れにはそれも入る
+    ISR_ENTER(ISR_RSPI0, start);
+
+    x = matrix_rspi_col_done();
+
+    tc_scan++;
+
+    // この列は次のフレームで DTC が送る
+    matrix_rspi_set_col(x, scan_col_data(x, 0));
+
+    scan_measure(start);
+    ISR_EXIT(ISR_RSPI0);
 }
+#endif
 
 // ICU IRQ0 SW6立下がり割込み
 void Excep_ICU_IRQ0(void)
 {
-	unsigned long now = tc_1ms;
-
-	// 前のIRQ発生から指定時間経ってなかったらreturn
-	if(now - tc_IRQ < MONITOR_CHATTERING_PERIOD_MS) return;
+    ISR_ENTER(ISR_IRQ0, ISR_NO_LATENCY);
 
-    Game_inst_ISR->is_buzzer_active ^= 1;
+	if(input_debounce(INPUT_SW6)) input_push(INPUT_SW6, 0);
 
-	tc_IRQ = now;
+    ISR_EXIT(ISR_IRQ0);
 }
 
 // ICU IRQ1 SW7立下がり割込み
 void Excep_ICU_IRQ1(void)
 {
-	unsigned long now = tc_1ms;
+    ISR_ENTER(ISR_IRQ1, ISR_NO_LATENCY);
 
-    // 前のIRQ発生から指定時間経ってなかったらreturn
-	if(now - tc_IRQ < MONITOR_CHATTERING_PERIOD_MS) return;
+	if(input_debounce(INPUT_SW7)) input_push(INPUT_SW7, 0);
 
-    IRQ1_flag = 1;
+    ISR_EXIT(ISR_IRQ1);
+}
+
+// SCI1 TXI1 送信データエンプティ割込み
+void Excep_SCI1_TXI1(void)
+{
+    ISR_ENTER(ISR_SCI1_TXI, ISR_NO_LATENCY);
+
+    sci_txi();
 
-    tc_IRQ = now;
+    ISR_EXIT(ISR_SCI1_TXI);
 }
 /**************************************************************************************************/
 /******************************************* 関数定義終 ********************************************/
@@ -1470,8 +2534,9 @@ void main(void)
     // 赤緑プレイヤー
     struct Player red, green;
 
-    // ロータリーエンコーダ入力
-    struct Rotary rotary;
+    // 割込みからの入力イベントと, 状態が受け取るまでためておく入力
+    struct InputEvent  ev;
+    struct PendingInput input;
 
     // コマ反転用フラグ
 	//　       右下  右上   左下   左上  右   左   下   上
@@ -1479,70 +2544,132 @@ void main(void)
 	// bit  :  0..その方角にひっくり返せない, 1..その方角にひっくり返せる
     unsigned char flip_dir_flag;
 
-    // 経過時間計測スタート
-    unsigned long start_tc = tc_1ms;
+    // 乱数シード
+    unsigned int seed;
+
+#ifdef STATE_PROFILE
+    // 前回のループでの状態
+    enum State prof_prev = INIT_HW;
+#endif
+
+#ifdef STACK_CHECK
+    stack_paint();
+#endif
 
-    // 割り込み(IRQ0)用インスタンス
-    Game_inst_ISR = &game;
+    init_Game(&game);
+    init_PendingInput(&input);
 
     init_RX210();
 
+#ifndef RESUME_NO_FLASH
+    resume_init();
+#endif
+#ifdef RECORD_FLASH
+    record_flash_init();
+#endif
+#ifdef STATE_PROFILE
+    prof_reset();
+#endif
+#ifdef ISR_PROFILE
+    isr_prof_reset();
+#endif
+
     while(1)
     {
-		// リセットボタン(sw5)を1秒間隔で監視
-    	if(tc_1ms - start_tc > 1000)
-    	{
-    		if(RESET_BTN_ON)
-			{
-    			beep(DO1, 50, game.is_buzzer_active);
-				game.count_to_reset++;
-			}
-			else
-			{
-				game.count_to_reset = 0;
-			}
+        // 入力イベントを全て取り出す. AIの思考中に来たものもここで受け取る.
+        while(input_pop(&ev))
+        {
+            switch(ev.type)
+            {
+                case INPUT_SW6:
+
+                    game.is_buzzer_active ^= 1;
+                    break;
+
+                case INPUT_SW7:
+
+                    input.decide++;
+                    break;
+
+                case INPUT_ROTARY:
+
+                    input.clicks += ev.value;
+                    break;
+
+                case INPUT_RESET_HOLD:
+
+                    // RESET_HOLD_COUNT 回続けて押されていたらリセット
+                    if(ev.value >= RESET_HOLD_COUNT)
+                    {
+                        beep(DO2, 300, game.is_buzzer_active);
+                        state = INIT_HW;
+                    }
+                    else
+                    {
+                        beep(DO1, 50, game.is_buzzer_active);
+                    }
 
-            // 2～3秒長押しされたらリセット
-    		if(game.count_to_reset > 2)
-    		{
-    			beep(DO2, 300, game.is_buzzer_active);
-    			state = INIT_HW;
-    		}
+                    break;
 
-    		start_tc = tc_1ms;
-    	}
+                default:
+                    break;
+            }
+        }
 
         switch(state)
         {
             //********** 初期化フェーズ **********//
             case INIT_HW:
 
-                clear_pulse_diff_cnt();
-                init_Rotary(&rotary);
+                anim_cancel();
+                input_flush();
+                init_PendingInput(&input);
                 state = INIT_GAME;
                 break;
 
             case INIT_GAME:
 
-                srand(get_AD0_val());
+                seed = get_AD0_val();
+                srand(seed);
                 init_Game(&game);
                 init_Player(&red, &green);
                 init_board(board);
+                HINT_CLEAR();
                 init_Cursor();
-                init_lcd_show(cursor.color);
+
+#ifndef RESUME_NO_FLASH
+                // 電源が切れる前の対局が残っていれば続きから. 置ける数を数え直して手番を表示する.
+                // 棋譜は続けた局面から取る.
+                if(resume_restore(board, &game))
+                {
+                    record_begin(seed, &game);
+                    record_mark_resumed(board, cursor.color, &game);
+                    flush_board(board);
+                    init_lcd_show(cursor.color);
+                    state = TURN_COUNT;
+                    break;
+                }
+
+                resume_clear();
+#endif
+
+                record_begin(seed, &game);
                 flush_board(board);
+                init_lcd_show(cursor.color);
                 state = SELECT_WAIT; 
                 //state = TURN_START;    
                 break;
             //********** 対戦モード選択フェーズ **********//
             case SELECT_WAIT:
 
-                if(IRQ1_flag)
+                // 決定はためてある回転を全て反映してから
+                if(input.decide && !input.clicks)
                 {
                 	beep(DO2, 200, game.is_buzzer_active);
                     lcd_show_whose_turn(cursor.color);
+                    record_set_mode(&game);
                     state = TURN_START;
-                    IRQ1_flag = 0;
+                    input.decide--;
                 }
                 else
                 {
@@ -1553,10 +2680,10 @@ void main(void)
 
             case SELECT_VS:
 
-				rotary.current_cnt = read_rotary() / PULSE_DIFF_PER_CLICK;
-
-				if(rotary.current_cnt != rotary.prev_cnt)
+				// 1クリックずつ切り替える
+				if(input.clicks)
 				{
+					input.clicks += (input.clicks > 0) ? -1 : 1;
 					beep(DO3, 50, game.is_buzzer_active);
 			   		game.is_vs_AI ^= 1;
 
@@ -1574,8 +2701,6 @@ void main(void)
 				    }
 				}
 
-				rotary.prev_cnt = rotary.current_cnt;
-
 				state = SELECT_WAIT;
 
             	break;
@@ -1594,6 +2719,9 @@ void main(void)
                 }
                 else
                 {
+                    // 置ける場所を暗く表示
+                    HINT_PLACEABLE(board, cursor.color);
+                    flush_board(board);
                     state = INPUT_WAIT;
                 }
 
@@ -1603,16 +2731,18 @@ void main(void)
             case AI_THINK:
 
                 set_AI_cursor_dest(board, cursor.color, (cursor.color == stone_red) ? red.placeable_count : green.placeable_count, AI_DEPTH);
+                push_AI_cursor_path(game.is_buzzer_active);
                 state = AI_MOVE;
                 break;
 
             //********** プレイヤー入力フェーズ **********//
             case INPUT_WAIT:
 
-                if(IRQ1_flag)
+                // 決定はためてある回転を全て反映してから
+                if(input.decide && !input.clicks)
                 {
                     state = PLACE_CHECK;
-                    IRQ1_flag = 0;
+                    input.decide--;
                 }
                 else
                 {
@@ -1623,21 +2753,21 @@ void main(void)
 
             case INPUT_READ:
 
-                rotary.current_cnt = read_rotary() / PULSE_DIFF_PER_CLICK;
-
-                if(is_rotary_turned_left(&rotary))
+                // 1クリックずつ動かす. 左回り(カウンター増加)
+                if(input.clicks > 0)
                 {
+                    input.clicks--;
                     move_cursor((MOVE_TYPE_UP_DOWN) ? DOWN : LEFT);
                     beep(C_SCALE[(MOVE_TYPE_UP_DOWN) ? cursor.y : cursor.x], 100, game.is_buzzer_active);
                 }
-                else if(is_rotary_turned_right(&rotary))
+                // 右回り(カウンター減少)
+                else if(input.clicks < 0)
                 {
+                    input.clicks++;
                     move_cursor((MOVE_TYPE_UP_DOWN) ? UP : RIGHT);
                     beep(C_SCALE[(MOVE_TYPE_UP_DOWN) ? cursor.y : cursor.x], 100, game.is_buzzer_active);
                 }
 
-                rotary.prev_cnt = rotary.current_cnt;
-
                 state = INPUT_WAIT;
 
                 break;
@@ -1645,34 +2775,12 @@ void main(void)
             //********** AI自動移動フェーズ **********//
             case AI_MOVE:
 
-                if(cursor.x < cursor.dest_x)
-                {
-                    beep(C_SCALE[cursor.x], 100, game.is_buzzer_active);
-                    move_cursor(RIGHT);
-                }
-                else if(cursor.x > cursor.dest_x)
-                {
-                    beep(C_SCALE[cursor.x], 100, game.is_buzzer_active);
-                    move_cursor(LEFT);
-                }
-
-                if(cursor.y < cursor.dest_y)
-                {
-                    beep(C_SCALE[cursor.y], 100, game.is_buzzer_active);
-                    move_cursor(UP);
-                }
-                else if(cursor.y > cursor.dest_y)
-                {
-                    beep(C_SCALE[cursor.y], 100, game.is_buzzer_active);
-                    move_cursor(DOWN);
-                }
-
-                if((cursor.x == cursor.dest_x) && (cursor.y == cursor.dest_y))
+                // カーソルの移動は1ms割込みがアニメーションキューから進める
+                if(anim_is_idle())
                 {
                     state = PLACE_CHECK;
                 }
 
-                wait_10ms(AI_MOVE_PERIOD_MS / 10);
                 break;
 
             //********** コマ配置フェーズ **********//
@@ -1681,6 +2789,7 @@ void main(void)
                 if(game.is_skip)
                 {
                     // スキップの場合は配置せずにターン終了
+                    record_push(RECORD_SKIP);
                     state = TURN_SWITCH;
                 }
                 else if(is_placeable(board, cursor.x, cursor.y, cursor.color))
@@ -1698,6 +2807,16 @@ void main(void)
 
             	beep(DO2, 100, game.is_buzzer_active);
                 place(board, cursor.x, cursor.y, cursor.color);
+                mark_col_dirty(cursor.x);
+                record_push(RECORD_MOVE(cursor.x, cursor.y));
+
+                // 置ける場所の表示を消し, AIの手は相手が打つまで暗く目立たせる
+                HINT_CLEAR();
+                if(game.is_AI_turn)
+                {
+                    HINT_LAST_MOVE(cursor.x, cursor.y, cursor.color);
+                }
+
                 flush_board(board);
                 state = FLIP_CALC;
                 break;
@@ -1718,7 +2837,7 @@ void main(void)
 
             case FLIP_RUN:
 
-                flip_stones(flip_dir_flag, board, cursor.x, cursor.y, cursor.color);
+                frame_dirty_cols |= flip_stones(flip_dir_flag, board, cursor.x, cursor.y, cursor.color);
                 flush_board(board);
                 state = TURN_SWITCH;
                 break;
@@ -1727,6 +2846,9 @@ void main(void)
             case TURN_SWITCH:
 
             	cursor.color = ((cursor.color == stone_red) ? stone_green : stone_red);
+#ifndef RESUME_NO_FLASH
+                resume_save(board, &game);
+#endif
                 state = TURN_COUNT;
                 break;
 
@@ -1755,6 +2877,7 @@ void main(void)
 
                 if(game.is_skip)
                 {
+                    melody_play(PHRASE_SKIP, game.is_buzzer_active);
                     lcd_show_skip_msg();
                 }
                 else
@@ -1773,6 +2896,10 @@ void main(void)
 
                 red.result   = count_stones(board, stone_red);
                 green.result = count_stones(board, stone_green);
+                record_end();
+#ifndef RESUME_NO_FLASH
+                resume_clear();
+#endif
                 state = END_SHOW;
                 break;
 
@@ -1783,24 +2910,45 @@ void main(void)
                 flush_lcd();
 
                 set_cursor_color(stone_black);
-                line_up_result(board, red.result, green.result, LINE_UP_RESULT_PERIOD_MS / 10, &game.is_buzzer_active);
+                HINT_CLEAR();
+                line_up_result(board, red.result, green.result, LINE_UP_RESULT_PERIOD_MS, game.is_buzzer_active);
+                state = END_LINE_UP;
+                break;
+
+            case END_LINE_UP:
+
+                if(anim_is_idle())
+                {
+                    lcd_show_winner(red.result, green.result);
+                    melody_play(PHRASE_RESULT, game.is_buzzer_active);
 
-                lcd_show_winner(red.result, green.result);
+                    // 結果表示の時間
+                    tw_start(&state_timer, SHOW_RESULT_WAIT_MS, 0, 0);
+                    state = END_RESULT;
+                }
+
+                break;
+
+            case END_RESULT:
 
-                wait_10ms(SHOW_RESULT_WAIT_MS / 10);
+                if(tw_fired(&state_timer))
+                {
+                    lcd_show_confirm();
 
-                lcd_show_confirm();
+                    state = END_WAIT;
+                    //state = INIT_HW;
+                }
 
-                state = END_WAIT; 
-				//state = INIT_HW; 
-				
                 break;
 
             case END_WAIT:
 
-                if(IRQ1_flag)
+                // 回転は使わないので捨てる. 残すと is_idle_state が偽のままで idle_sleep が止まらない.
+                input.clicks = 0;
+
+                if(input.decide)
                 {
-                    IRQ1_flag = 0;
+                    input.decide--;
                     state = END_RESET;
                 }
 
@@ -1815,6 +2963,45 @@ void main(void)
                 break;
 
         }
+
+#ifdef STATE_PROFILE
+        if(state != prof_prev)
+        {
+            prof_transition(prof_prev, state);
+            prof_prev = state;
+        }
+#endif
+
+        // 端末からのコマンド
+        switch(sci_getc())
+        {
+#ifdef STATE_PROFILE
+            case 'p': prof_dump(); break;
+#endif
+#ifdef ISR_PROFILE
+            case 'i': isr_dump();  break;
+#endif
+#ifdef STACK_CHECK
+            case 's': stack_dump(); break;
+#endif
+            case 'g': record_dump(); break;
+#ifdef RECORD_FLASH
+            case 'f': record_flash_dump(); break;
+#endif
+            case 'c':
+#ifdef STATE_PROFILE
+                prof_reset();
+#endif
+#ifdef ISR_PROFILE
+                isr_prof_reset();
+#endif
+                break;
+            default:
+                break;
+        }
+
+        // 割込みを待つだけの状態ならCPUを止める
+        idle_sleep(state, &input);
     }
 }
 
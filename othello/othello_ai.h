@@ -0,0 +1,827 @@
+/*********************************************************************************************/
+//
+//  FILE        : othello_ai.h
+//  DATE        : 2025/11/25 Tue.
+//  DESCRIPTION : 盤面ロジックとAI探索
+//  CPU TYPE    : RX Family / ホストPC
+//
+//  Author T.Ijiro
+//
+//  ハードウェアに依存しない盤面操作とAI探索をまとめたもの.
+//  othello.c とホスト用ツール(host/)の両方からインクルードする.
+//  iodefine.h などのRX専用ヘッダはここでインクルードしないこと.
+/************************************************************************************************/
+#ifndef OTHELLO_AI_H_
+#define OTHELLO_AI_H_
+
+#include <string.h>
+
+/************************************ マクロ *************************************************/
+// 盤面
+#define MAT_WIDTH  8 // 横のコマ数
+#define MAT_HEIGHT 8 // 縦のコマ数
+
+// AIの先読みの回数
+#ifndef AI_DEPTH
+#define AI_DEPTH 4
+#endif
+
+// 無限大の代わりに使用する大きな値
+#define INF 100000
+
+// 評価値キャッシュのエントリ数 = 2 ^ EVAL_CACHE_BITS
+#ifndef EVAL_CACHE_BITS
+#define EVAL_CACHE_BITS 8
+#endif
+#define EVAL_CACHE_SIZE (1 << EVAL_CACHE_BITS)
+
+// 評価関数の重み係数と盤面のスコア定義
+#include "eval_weights.h"
+/********************************************************************************************/
+
+
+/********************************************* 定数 *************************************************/
+// 置き判定の時の8方向の移動量
+//                        　　　　上       下       左       右      左上      左下     右上     右下
+static const int DXDY[8][2] = {{0, 1}, {0, -1}, {-1, 0}, {1, 0}, {-1, 1}, {-1, -1}, {1, 1}, {1, -1}};
+/*******************************************************************************************/
+
+
+/**************************************** 型定義 ********************************************/
+// マトリックスLEDの色
+enum stone_color{
+    stone_red,  // 赤コマ
+    stone_green,// 緑コマ
+    stone_black // 何も置かれていない
+};
+
+// 手の情報を保持する. AI推論用
+struct Move{
+    int x;     // x座標
+    int y;     // y座標
+    int score; // 手のスコア
+};
+/****************************************************************************************/
+
+// データフラッシュに残す盤面の形式. enum stone_color を使うのでここでインクルードする.
+#include "packed_board.h"
+
+// ビットボードと対称性による正規化. enum stone_color を使うのでここでインクルードする.
+#include "othello_sym.h"
+
+/**************************************** 型定義 ********************************************/
+// 評価値キャッシュのエントリ. 盤面とAIの色が一致したら score を使う.
+struct EvalCacheEntry{
+    struct BitBoard  key;      // 盤面
+    enum stone_color ai_color; // 評価したAIの色
+    int              score;    // evaluate_board の値
+};
+/****************************************************************************************/
+
+/************************************************** AI推論用グローバル変数 **************************************************/
+// グローバル静的バッファ
+static enum stone_color ai_buf[AI_DEPTH + 1][MAT_HEIGHT][MAT_WIDTH]; // 深さごとのシミュレーションバッファ
+static struct Move      ai_moves[AI_DEPTH][MAT_HEIGHT * MAT_WIDTH];  // 各深さでの候補手リスト
+static int              ai_move_counts[AI_DEPTH];                    // 各深さでの候補手数
+static unsigned long    ai_node_count;                               // 探索したノード数. ベンチマーク用.
+
+// 評価値キャッシュ. 盤面の評価値は探索の深さや枝刈りに依存しないので消去しない.
+// 空のエントリ(コマなし, 赤)は実際の探索では現れない盤面なので有効フラグは持たない.
+static struct EvalCacheEntry eval_cache[EVAL_CACHE_SIZE];
+static unsigned long         eval_cache_hits;   // キャッシュヒット数
+static unsigned long         eval_cache_misses; // キャッシュミス数
+/***************************************************************************************************************************/
+
+
+/************************************ メモリ使用量 *************************************************/
+// 先読みの回数 d のときのAI用バッファのバイト数. 深さごとの表は host/bench_suite -m で出す.
+#define AI_BUF_BYTES(d)         (((d) + 1) * MAT_HEIGHT * MAT_WIDTH * sizeof(enum stone_color)) // ai_buf
+#define AI_MOVES_BYTES(d)       ((d) * MAT_HEIGHT * MAT_WIDTH * sizeof(struct Move))            // ai_moves
+#define AI_MOVE_COUNTS_BYTES(d) ((d) * sizeof(int))                                             // ai_move_counts
+#define EVAL_CACHE_BYTES        (EVAL_CACHE_SIZE * sizeof(struct EvalCacheEntry))               // eval_cache (深さによらない)
+#define AI_STATIC_BYTES(d)      (AI_BUF_BYTES(d) + AI_MOVES_BYTES(d) + AI_MOVE_COUNTS_BYTES(d) + EVAL_CACHE_BYTES)
+#define AI_STACK_BYTES(d)       (5 * ((d) + 1) * sizeof(int)) // minimax_alphabeta の stack_* (スタックに取る)
+
+// 式とバッファの宣言がずれたらコンパイルエラーにする
+typedef char ai_static_bytes_check[(AI_STATIC_BYTES(AI_DEPTH) == sizeof(ai_buf) + sizeof(ai_moves)
+                                    + sizeof(ai_move_counts) + sizeof(eval_cache)) ? 1 : -1];
+
+// AI_RAM_LIMIT [byte] を定義すると, AI用の静的バッファがそれを超えたらコンパイルエラーにする
+#ifdef AI_RAM_LIMIT
+typedef char ai_ram_limit_check[(AI_STATIC_BYTES(AI_DEPTH) <= AI_RAM_LIMIT) ? 1 : -1];
+#endif
+/********************************************************************************************/
+
+
+/************************************** コマ/盤面 ********************************************* */
+// 何も置かれてないか, または何色が置かれているか
+enum stone_color read_stone_at(enum stone_color brd[][MAT_WIDTH], int x, int y)
+{
+   return brd[y][x];
+}
+
+// 指定した色のコマを置く
+void place(enum stone_color brd[][MAT_WIDTH], int x, int y, enum stone_color sc)
+{
+    brd[y][x] = sc;
+}
+
+// 指定した座標のコマを消す
+void delete(enum stone_color brd[][MAT_WIDTH], int x, int y)
+{
+    brd[y][x] = stone_black;
+}
+
+// 座標範囲外か
+int is_out_of_board(int x, int y)
+{
+    return ((x < 0) || (y < 0) || ( x > MAT_WIDTH  - 1) || (y > MAT_HEIGHT - 1));
+}
+
+// 8方向のひっくり返しフラグを作る
+//　       右下  右上  左下  左上  右   左   下   上
+// flag :  b7    b6    b5    b4  b3   b2   b1   b0
+// bit  :  0..その方角にひっくり返せない, 1..その方角にひっくり返せる
+unsigned char make_flip_dir_flag(enum stone_color brd[][MAT_WIDTH], int x, int y, enum stone_color sc)
+{
+    int dir, i;
+    int dx, dy;
+    unsigned char flag = 0x00;
+
+    enum stone_color search;
+
+    for(dir = 0; dir < 8; dir++)
+    {
+        dx = dy = 0;
+
+        for(i = 0; i < 8; i++)
+        {
+            dx += DXDY[dir][0];
+            dy += DXDY[dir][1];
+
+            // 範囲外ならbreak
+            if(is_out_of_board(x + dx, y + dy)) break;
+
+            // コマの色を調査
+            search = read_stone_at(brd, x + dx, y + dy);
+
+            // 何も置かれていなかったらbreak
+            if(search == stone_black) break;
+
+            // 挟む側のコマの色に遭遇
+            if(search == sc)
+            {
+                // i > 0 の時点で相手色を少なくとも1つは挟んでいる
+                if(i > 0)
+                {
+                    flag |= (1 << dir);
+                }
+
+                break;
+            }
+        }
+    }
+
+    return flag;
+}
+
+// 少なくとも1方向は挟めるか. make_flip_dir_flag の早期終了版で, 配置可能数の数え上げに使う.
+int can_flip_any_dir(enum stone_color brd[][MAT_WIDTH], int x, int y, enum stone_color sc)
+{
+    int dir, i;
+    int dx, dy;
+    enum stone_color search;
+
+    for(dir = 0; dir < 8; dir++)
+    {
+        dx = dy = 0;
+
+        for(i = 0; i < 8; i++)
+        {
+            dx += DXDY[dir][0];
+            dy += DXDY[dir][1];
+
+            if(is_out_of_board(x + dx, y + dy)) break;
+
+            search = read_stone_at(brd, x + dx, y + dy);
+
+            if(search == stone_black) break;
+
+            if(search == sc)
+            {
+                if(i > 0) return 1;
+
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
+
+//その場所にその色は置けるか？
+int is_placeable(enum stone_color brd[][MAT_WIDTH], int x, int y, enum stone_color sc)
+{
+    unsigned char flag;
+
+    // 何かおいてあったらだめ
+    if(read_stone_at(brd, x, y) != stone_black) return 0;
+
+     // 8方向フラグ作成
+    flag = make_flip_dir_flag(brd, x, y, sc);
+
+    // flag != 0x00なら少なくとも1方向は挟める
+    return (flag != 0x00);
+}
+
+// 8方向フラグをつかって相手のコマをひっくり返す
+// 戻り値 : ひっくり返したコマがある列のビット(b0 = x0). 表示の部分更新に使う.
+unsigned char flip_stones(unsigned char flag, enum stone_color brd[][MAT_WIDTH], int x, int y, enum stone_color sc)
+{
+    int dir, i;
+    int dx, dy;
+    enum stone_color search;
+    unsigned char cols = 0x00;
+
+    for(dir = 0; dir < 8; dir++)
+    {
+        dx = dy = 0;
+
+        if(flag & (1 << dir))
+        {
+            for(i = 0; i < 8; i++)
+            {
+                dx += DXDY[dir][0];
+                dy += DXDY[dir][1];
+
+                // コマの色をチェック
+                search = read_stone_at(brd, x + dx, y + dy);
+
+                // 置きチェック済みなので確認するのは自分の色が出たかのみ
+                if(search == sc)
+                {
+                    break;
+                }
+
+                // 新しくコマを置く
+                place(brd, x + dx, y + dy, (search == stone_red) ? stone_green : stone_red);
+                cols |= 1 << (x + dx);
+            }
+        }
+    }
+
+    return cols;
+}
+
+// ボード上にその色のコマが置ける場所はあるか
+int count_placeable(enum stone_color brd[][MAT_WIDTH], enum stone_color sc)
+{
+    int x, y;
+    int count = 0;
+
+    for(x = 0; x < MAT_WIDTH; x++)
+    {
+        for(y = 0; y < MAT_HEIGHT; y++)
+        {
+            if(is_placeable(brd, x, y, sc))
+            {
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+// 指定した色のコマの数を数える
+int count_stones(enum stone_color brd[][MAT_WIDTH], enum stone_color sc)
+{
+    int x, y;
+    int count = 0;
+
+    for(x = 0; x < MAT_WIDTH; x++)
+    {
+        for(y = 0; y < MAT_HEIGHT; y++)
+        {
+            if(read_stone_at(brd, x, y) == sc)
+            {
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+// どっちも置けなかったらおわり
+int is_game_over(int stone1_placeable_count, int stone2_placeable_count)
+{
+    return (!stone1_placeable_count && !stone2_placeable_count);
+}
+
+/*****************************************************************************/
+
+
+/********************************************* AI ***********************************************/
+// 盤面の位置評価を計算
+int evaluate_position_weight(enum stone_color brd[][MAT_WIDTH], enum stone_color ai_color)
+{
+    int x, y;
+    int ai_score = 0;
+    int opp_score = 0;
+    enum stone_color opp_color = (ai_color == stone_red) ? stone_green : stone_red;
+
+    for(y = 0; y < MAT_HEIGHT; y++)
+    {
+        for(x = 0; x < MAT_WIDTH; x++)
+        {
+            if(read_stone_at(brd, x, y) == ai_color)
+            {
+                ai_score += POSITION_WEIGHTS[y][x];
+            }
+            else if(read_stone_at(brd, x, y) == opp_color)
+            {
+                opp_score += POSITION_WEIGHTS[y][x];
+            }
+        }
+    }
+
+    return ai_score - opp_score;
+}
+
+// コマの数の差を計算. 終盤用.
+int evaluate_stone_count(enum stone_color brd[][MAT_WIDTH], enum stone_color ai_color)
+{
+    int x, y;
+    int ai_count = 0;
+    int opp_count = 0;
+    enum stone_color opp_color = (ai_color == stone_red) ? stone_green : stone_red;
+
+    for(y = 0; y < MAT_HEIGHT; y++)
+    {
+        for(x = 0; x < MAT_WIDTH; x++)
+        {
+            if(read_stone_at(brd, x, y) == ai_color)
+            {
+                ai_count++;
+            }
+            else if(read_stone_at(brd, x, y) == opp_color)
+            {
+                opp_count++;
+            }
+        }
+    }
+
+    return ai_count - opp_count;
+}
+
+// 絶対に取られないコマの数を計算
+int count_stable_stones(enum stone_color brd[][MAT_WIDTH], enum stone_color color)
+{
+    int stable_count = 0;
+
+    // 角のコマは確定石
+    if(read_stone_at(brd, 0,           0             ) == color) stable_count++;
+    if(read_stone_at(brd, MAT_WIDTH-1, 0             ) == color) stable_count++;
+    if(read_stone_at(brd, 0,           MAT_HEIGHT - 1) == color) stable_count++;
+    if(read_stone_at(brd, MAT_WIDTH-1, MAT_HEIGHT - 1) == color) stable_count++;
+
+    return stable_count;
+}
+
+// 盤面を評価する関数. AI視点でのスコア. キャッシュを使わずに計算する.
+int compute_board_score(enum stone_color brd[][MAT_WIDTH], enum stone_color ai_color)
+{
+    enum stone_color opp_color = (ai_color == stone_red) ? stone_green : stone_red;
+    int position_score, mobility_score, stable_score;
+    int ai_stable, opp_stable;
+
+    // 位置評価
+    position_score = evaluate_position_weight(brd, ai_color);
+
+    // 配置可能数評価. 相手の手数が少ないほど有利.
+    mobility_score = -count_placeable(brd, opp_color);
+
+    // 確定石評価
+    ai_stable = count_stable_stones(brd, ai_color);
+    opp_stable = count_stable_stones(brd, opp_color);
+    stable_score = (ai_stable - opp_stable) * STABLE_WEIGHT;
+
+    return position_score * POS_WEIGHT + mobility_score * MOBILITY_WEIGHT + stable_score;
+}
+
+// 評価値キャッシュを引く. ヒットしたら1を返す.
+// ミスしたときは *entry のキーを書き換えるので, 呼び出し側が score を書き込む.
+// 正規形(canonicalize)をキーにすると対称な局面も共有できるが, 先読み4では
+// ヒット率がほぼ変わらず8通りの変換の分だけ遅くなるので, そのままの盤面をキーにする.
+int eval_cache_find(enum stone_color brd[][MAT_WIDTH], enum stone_color ai_color, struct EvalCacheEntry **entry)
+{
+    struct BitBoard key;
+    uint64_t hash;
+    struct EvalCacheEntry *e;
+
+    board_to_bits(brd, &key);
+    hash = bits_hash(&key);
+
+    e = &eval_cache[(hash ^ (hash >> 32) ^ (uint64_t)ai_color) & (EVAL_CACHE_SIZE - 1)];
+    *entry = e;
+
+    if((e->key.red == key.red) && (e->key.green == key.green) && (e->ai_color == ai_color))
+    {
+        eval_cache_hits++;
+        return 1;
+    }
+
+    eval_cache_misses++;
+    e->key      = key;
+    e->ai_color = ai_color;
+
+    return 0;
+}
+
+// 盤面を評価する関数. AI視点でのスコア.
+int evaluate_board(enum stone_color brd[][MAT_WIDTH], enum stone_color ai_color)
+{
+    struct EvalCacheEntry *entry;
+
+    if(eval_cache_find(brd, ai_color, &entry))
+    {
+        return entry->score;
+    }
+
+    entry->score = compute_board_score(brd, ai_color);
+
+    return entry->score;
+}
+
+// 探索の末端の1つ手前のノードで, 子ノード(葉)をまとめて評価する.
+// 親の位置評価と空きマスは兄弟で共通なので一度だけ計算し, 子は差分だけを調べる.
+// αβ枝刈りの条件は葉を1つずつ評価する場合と同じ.
+// 戻り値 : 枝刈りしたら1, *best_score にこのノードの評価値
+int evaluate_frontier(enum stone_color parent[][MAT_WIDTH], enum stone_color child[][MAT_WIDTH],
+                      const struct Move *moves, int move_count, enum stone_color current_color,
+                      enum stone_color ai_color, int is_max_player, int alpha, int beta, int *best_score)
+{
+    enum stone_color opp_color = (ai_color == stone_red) ? stone_green : stone_red;
+    const enum stone_color *p = &parent[0][0];
+    const enum stone_color *c = &child[0][0];
+    const int *w = &POSITION_WEIGHTS[0][0];
+    int empties[MAT_HEIGHT * MAT_WIDTH];
+    int empty_count = 0;
+    int parent_position, position_delta, mobility, stable_score, score;
+    int i, j, cell, x, y;
+    struct EvalCacheEntry *entry;
+
+    // 兄弟で共通の計算
+    parent_position = evaluate_position_weight(parent, ai_color);
+
+    for(cell = 0; cell < MAT_HEIGHT * MAT_WIDTH; cell++)
+    {
+        if(p[cell] == stone_black)
+        {
+            empties[empty_count++] = cell;
+        }
+    }
+
+    *best_score = is_max_player ? -INF : INF;
+
+    for(i = 0; i < move_count; i++)
+    {
+        x = moves[i].x;
+        y = moves[i].y;
+
+        // 手を打つ
+        memcpy(child, parent, sizeof(enum stone_color) * MAT_HEIGHT * MAT_WIDTH);
+        flip_stones(make_flip_dir_flag(child, x, y, current_color), child, x, y, current_color);
+        ai_node_count++;
+
+        if(eval_cache_find(child, ai_color, &entry))
+        {
+            score = entry->score;
+        }
+        else
+        {
+            // 位置評価の差分. 分岐のない64マスの積和なのでホストではSIMD化される.
+            position_delta = 0;
+            for(cell = 0; cell < MAT_HEIGHT * MAT_WIDTH; cell++)
+            {
+                position_delta += w[cell] * (((c[cell] == ai_color) - (c[cell] == opp_color))
+                                           - ((p[cell] == ai_color) - (p[cell] == opp_color)));
+            }
+
+            // 配置可能数評価. 親で空いていたマスだけを調べる.
+            mobility = 0;
+            for(j = 0; j < empty_count; j++)
+            {
+                cell = empties[j];
+
+                if(c[cell] == stone_black && can_flip_any_dir(child, cell % MAT_WIDTH, cell / MAT_WIDTH, opp_color))
+                {
+                    mobility++;
+                }
+            }
+
+            // 確定石評価
+            stable_score = (count_stable_stones(child, ai_color) - count_stable_stones(child, opp_color)) * STABLE_WEIGHT;
+
+            score = (parent_position + position_delta) * POS_WEIGHT - mobility * MOBILITY_WEIGHT + stable_score;
+            entry->score = score;
+        }
+
+        if(is_max_player)
+        {
+            if(score > *best_score)
+                *best_score = score;
+
+            // β枝刈り
+            if(*best_score >= beta) return 1;
+
+            if(*best_score > alpha)
+                alpha = *best_score;
+        }
+        else
+        {
+            if(score < *best_score)
+                *best_score = score;
+
+            // α枝刈り
+            if(*best_score <= alpha) return 1;
+
+            if(*best_score < beta)
+                beta = *best_score;
+        }
+    }
+
+    return 0;
+}
+
+// ミニマックス法 + αβ枝刈り
+int minimax_alphabeta(enum stone_color brd[][MAT_WIDTH], enum stone_color ai_color, int max_depth)
+{
+    int depth, x, y, i, move_idx;
+    enum stone_color current_color;
+    int score, best_score;
+    int is_max_player;
+
+    // スタック用の変数
+    int stack_alpha[AI_DEPTH + 1];
+    int stack_beta[AI_DEPTH + 1];
+    int stack_best_score[AI_DEPTH + 1];
+    int stack_move_idx[AI_DEPTH + 1];
+    int stack_is_max[AI_DEPTH + 1];
+
+    // 初期化
+    memcpy(ai_buf[0], brd, sizeof(enum stone_color) * MAT_HEIGHT * MAT_WIDTH);
+    ai_node_count = 1;
+
+    // ルートノードの候補手を生成
+    ai_move_counts[0] = 0;
+    for(y = 0; y < MAT_HEIGHT; y++)
+    {
+        for(x = 0; x < MAT_WIDTH; x++)
+        {
+            if(is_placeable(ai_buf[0], x, y, ai_color))
+            {
+                ai_moves[0][ai_move_counts[0]].x = x;
+                ai_moves[0][ai_move_counts[0]].y = y;
+                ai_moves[0][ai_move_counts[0]].score = -INF;
+                ai_move_counts[0]++;
+            }
+        }
+    }
+
+    if(ai_move_counts[0] == 0) return -INF;
+
+    best_score = -INF;
+
+    // 各候補手を評価
+    for(i = 0; i < ai_move_counts[0]; i++)
+    {
+        x = ai_moves[0][i].x;
+        y = ai_moves[0][i].y;
+
+        // 手を打つ
+        memcpy(ai_buf[1], ai_buf[0], sizeof(enum stone_color) * MAT_HEIGHT * MAT_WIDTH);
+        ai_node_count++;
+        flip_stones(make_flip_dir_flag(ai_buf[1], x, y, ai_color), ai_buf[1], x, y, ai_color);
+
+        // 深さ1から探索開始
+        depth = 1;
+        stack_alpha[1] = -INF;
+        stack_beta[1] = INF;
+        stack_move_idx[1] = 0;
+        stack_is_max[1] = 0;  // 次は相手のターン
+        score = -INF;
+
+        while(depth > 0)
+        {
+            if(depth >= max_depth)
+            {
+                // 葉ノード：評価値を計算
+                score = evaluate_board(ai_buf[depth], ai_color);
+                depth--;
+
+                if(depth > 0)
+                {
+                    if(stack_is_max[depth])
+                    {
+                        if(score > stack_best_score[depth])
+                            stack_best_score[depth] = score;
+
+                        if(stack_best_score[depth] >= stack_beta[depth])
+                        {
+                            // β枝刈り
+                            score = stack_best_score[depth];
+                            depth--;
+                            if(depth > 0)
+                            {
+                                stack_move_idx[depth]++;
+                            }
+                            continue;
+                        }
+
+                        if(stack_best_score[depth] > stack_alpha[depth])
+                            stack_alpha[depth] = stack_best_score[depth];
+                    }
+                    else
+                    {
+                        if(score < stack_best_score[depth])
+                            stack_best_score[depth] = score;
+
+                        if(stack_best_score[depth] <= stack_alpha[depth])
+                        {
+                            // α枝刈り
+                            score = stack_best_score[depth];
+                            depth--;
+                            if(depth > 0)
+                            {
+                                stack_move_idx[depth]++;
+                            }
+                            continue;
+                        }
+
+                        if(stack_best_score[depth] < stack_beta[depth])
+                            stack_beta[depth] = stack_best_score[depth];
+
+                    }
+                    stack_move_idx[depth]++;
+                }
+                continue;
+            }
+
+            // 現在のプレイヤー
+            is_max_player = stack_is_max[depth];
+            current_color = (depth % 2 == 1) ? (ai_color == stone_red ? stone_green : stone_red) : ai_color;
+
+            // 初回訪問時：候補手を生成
+            if(stack_move_idx[depth] == 0)
+            {
+                ai_move_counts[depth] = 0;
+                for(y = 0; y < MAT_HEIGHT; y++)
+                {
+                    for(x = 0; x < MAT_WIDTH; x++)
+                    {
+                        if(is_placeable(ai_buf[depth], x, y, current_color))
+                        {
+                            ai_moves[depth][ai_move_counts[depth]].x = x;
+                            ai_moves[depth][ai_move_counts[depth]].y = y;
+                            ai_move_counts[depth]++;
+                        }
+                    }
+                }
+
+                // 手がない場合
+                if(ai_move_counts[depth] == 0)
+                {
+                    // パス：評価値を返す
+                    score = evaluate_board(ai_buf[depth], ai_color);
+                    depth--;
+
+                    if(depth > 0)
+                    {
+                        if(stack_is_max[depth])
+                        {
+                            if(score > stack_best_score[depth])
+                                stack_best_score[depth] = score;
+
+                        }
+                        else
+                        {
+                            if(score < stack_best_score[depth])
+                                stack_best_score[depth] = score;
+                        }
+
+                        stack_move_idx[depth]++;
+                    }
+                    continue;
+                }
+
+                stack_best_score[depth] = is_max_player ? -INF : INF;
+
+                // 子ノードが葉ならまとめて評価する
+                if(depth + 1 >= max_depth)
+                {
+                    if(evaluate_frontier(ai_buf[depth], ai_buf[depth + 1], ai_moves[depth], ai_move_counts[depth],
+                                         current_color, ai_color, is_max_player,
+                                         stack_alpha[depth], stack_beta[depth], &stack_best_score[depth]))
+                    {
+                        // 枝刈り
+                        score = stack_best_score[depth];
+                        depth--;
+                        if(depth > 0)
+                        {
+                            stack_move_idx[depth]++;
+                        }
+                        continue;
+                    }
+
+                    // すべての手を評価済みとして親に返す
+                    stack_move_idx[depth] = ai_move_counts[depth];
+                }
+            }
+
+            // すべての手を評価済み
+            if(stack_move_idx[depth] >= ai_move_counts[depth])
+            {
+                score = stack_best_score[depth];
+                depth--;
+
+                if(depth > 0)
+                {
+                    if(stack_is_max[depth])
+                    {
+                        if(score > stack_best_score[depth])
+                            stack_best_score[depth] = score;
+
+                        if(stack_best_score[depth] >= stack_beta[depth])
+                        {
+                            // β枝刈り
+                            score = stack_best_score[depth];
+                            depth--;
+                            if(depth > 0)
+                            {
+                                stack_move_idx[depth]++;
+                            }
+                            continue;
+                        }
+
+                        if(stack_best_score[depth] > stack_alpha[depth])
+                            stack_alpha[depth] = stack_best_score[depth];
+                    }
+                    else
+                    {
+                        if(score < stack_best_score[depth])
+                            stack_best_score[depth] = score;
+
+                        if(stack_best_score[depth] <= stack_alpha[depth])
+                        {
+                            // α枝刈り
+                            score = stack_best_score[depth];
+                            depth--;
+                            if(depth > 0)
+                            {
+                                stack_move_idx[depth]++;
+                            }
+                            continue;
+                        }
+
+                        if(stack_best_score[depth] < stack_beta[depth])
+                            stack_beta[depth] = stack_best_score[depth];
+                    }
+
+                    stack_move_idx[depth]++;
+                }
+                continue;
+            }
+
+            // 次の手を試す
+            move_idx = stack_move_idx[depth];
+            x = ai_moves[depth][move_idx].x;
+            y = ai_moves[depth][move_idx].y;
+
+            // 手を打つ
+            memcpy(ai_buf[depth + 1], ai_buf[depth], sizeof(enum stone_color) * MAT_HEIGHT * MAT_WIDTH);
+            ai_node_count++;
+            flip_stones(make_flip_dir_flag(ai_buf[depth + 1], x, y, current_color), ai_buf[depth + 1], x, y, current_color);
+
+            // 次の深さへ
+            depth++;
+            stack_alpha[depth] = stack_alpha[depth - 1];
+            stack_beta[depth] = stack_beta[depth - 1];
+            stack_move_idx[depth] = 0;
+            stack_is_max[depth] = !is_max_player;
+        }
+
+        ai_moves[0][i].score = score;
+        if(score > best_score)
+        {
+            best_score = score;
+        }
+    }
+
+    return best_score;
+}
+
+/*************************************************************************************************/
+
+#endif /* OTHELLO_AI_H_ */
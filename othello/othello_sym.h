@@ -0,0 +1,177 @@
+/*********************************************************************************************/
+//
+//  FILE        : othello_sym.h
+//  DATE        : 2025/11/25 Tue.
+//  DESCRIPTION : 盤面の対称性(回転・反転)による正規化
+//  CPU TYPE    : RX Family / ホストPC
+//
+//  Author T.Ijiro
+//
+//  盤面は回転・反転で8通りの同じ局面になる. 8通りをビットボードで作り,
+//  ハッシュ値が最小のものを正規形とする. キャッシュや定石の検索は正規形で行い,
+//  見つけた手は sym_from_canonical_xy で実際の向きの座標に戻す.
+//  othello_ai.h からインクルードされる.
+//
+//  ビットボード : brd[y][x] をビット y * 8 + x に対応させる
+//  対称変換番号 : b2 = x と y を入れ替え, b1 = 上下反転, b0 = 左右反転 (この順に適用)
+/************************************************************************************************/
+#ifndef OTHELLO_SYM_H_
+#define OTHELLO_SYM_H_
+
+#include <stdint.h>
+
+/************************************ マクロ *************************************************/
+#define SYM_COUNT     8 // 対称変換の数
+#define SYM_MIRROR_X  1 // 左右反転
+#define SYM_FLIP_Y    2 // 上下反転
+#define SYM_TRANSPOSE 4 // x と y の入れ替え
+/********************************************************************************************/
+
+
+/**************************************** 型定義 ********************************************/
+// ビットボード
+struct BitBoard{
+    uint64_t red;   // 赤コマ
+    uint64_t green; // 緑コマ
+};
+/****************************************************************************************/
+
+
+/************************************** ビットボード ********************************************* */
+// 盤面をビットボードに変換. 32ビットずつ作る pack_board (packed_board.h) を使う.
+void board_to_bits(enum stone_color brd[][MAT_WIDTH], struct BitBoard *bb)
+{
+    struct PackedBoard pb;
+
+    pack_board(brd, &pb);
+
+    bb->red   = ((uint64_t)pb.red[1]   << 32) | pb.red[0];
+    bb->green = ((uint64_t)pb.green[1] << 32) | pb.green[0];
+}
+
+// 上下反転 (y -> 7 - y). 8バイトの並びを逆にする.
+uint64_t bits_flip_y(uint64_t b)
+{
+    b = ((b >>  8) & 0x00FF00FF00FF00FFULL) | ((b & 0x00FF00FF00FF00FFULL) <<  8);
+    b = ((b >> 16) & 0x0000FFFF0000FFFFULL) | ((b & 0x0000FFFF0000FFFFULL) << 16);
+    b = (b >> 32) | (b << 32);
+
+    return b;
+}
+
+// 左右反転 (x -> 7 - x). 各バイトのビットの並びを逆にする.
+uint64_t bits_mirror_x(uint64_t b)
+{
+    b = ((b >> 1) & 0x5555555555555555ULL) | ((b & 0x5555555555555555ULL) << 1);
+    b = ((b >> 2) & 0x3333333333333333ULL) | ((b & 0x3333333333333333ULL) << 2);
+    b = ((b >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((b & 0x0F0F0F0F0F0F0F0FULL) << 4);
+
+    return b;
+}
+
+// x と y の入れ替え (対角線で反転)
+uint64_t bits_transpose(uint64_t b)
+{
+    uint64_t t;
+
+    t = 0x0F0F0F0F00000000ULL & (b ^ (b << 28));
+    b ^= t ^ (t >> 28);
+    t = 0x3333000033330000ULL & (b ^ (b << 14));
+    b ^= t ^ (t >> 14);
+    t = 0x5500550055005500ULL & (b ^ (b <<  7));
+    b ^= t ^ (t >>  7);
+
+    return b;
+}
+
+// 対称変換番号 sym の変換をかける
+uint64_t bits_transform(uint64_t b, int sym)
+{
+    if(sym & SYM_TRANSPOSE) b = bits_transpose(b);
+    if(sym & SYM_FLIP_Y)    b = bits_flip_y(b);
+    if(sym & SYM_MIRROR_X)  b = bits_mirror_x(b);
+
+    return b;
+}
+
+// ビットボードのハッシュ値
+uint64_t bits_hash(const struct BitBoard *bb)
+{
+    uint64_t h = bb->red * 0x9E3779B97F4A7C15ULL;
+
+    h ^= (bb->green + 0x632BE59BD9B4E019ULL) * 0xC2B2AE3D27D4EB4FULL;
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 29;
+
+    return h;
+}
+/*****************************************************************************/
+
+
+/************************************** 正規化 ********************************************* */
+// 8通りの向きのうちハッシュ値が最小のものを正規形にする. ハッシュ値が同じならビットボードの小さい方.
+// 戻り値 : 実際の向きから正規形への対称変換番号
+int canonicalize(enum stone_color brd[][MAT_WIDTH], struct BitBoard *canon, uint64_t *hash)
+{
+    struct BitBoard bb, t;
+    uint64_t h;
+    int sym, best_sym = 0;
+
+    board_to_bits(brd, &bb);
+
+    *canon = bb;
+    *hash  = bits_hash(&bb);
+
+    for(sym = 1; sym < SYM_COUNT; sym++)
+    {
+        t.red   = bits_transform(bb.red, sym);
+        t.green = bits_transform(bb.green, sym);
+        h = bits_hash(&t);
+
+        if((h < *hash) ||
+           ((h == *hash) && ((t.red < canon->red) || ((t.red == canon->red) && (t.green < canon->green)))))
+        {
+            *canon   = t;
+            *hash    = h;
+            best_sym = sym;
+        }
+    }
+
+    return best_sym;
+}
+
+// 実際の向きの座標を正規形の座標に変換
+void sym_to_canonical_xy(int sym, int *x, int *y)
+{
+    int t;
+
+    if(sym & SYM_TRANSPOSE)
+    {
+        t = *x;
+        *x = *y;
+        *y = t;
+    }
+
+    if(sym & SYM_FLIP_Y)   *y = (MAT_HEIGHT - 1) - *y;
+    if(sym & SYM_MIRROR_X) *x = (MAT_WIDTH  - 1) - *x;
+}
+
+// 正規形の座標を実際の向きの座標に戻す
+void sym_from_canonical_xy(int sym, int *x, int *y)
+{
+    int t;
+
+    if(sym & SYM_MIRROR_X) *x = (MAT_WIDTH  - 1) - *x;
+    if(sym & SYM_FLIP_Y)   *y = (MAT_HEIGHT - 1) - *y;
+
+    if(sym & SYM_TRANSPOSE)
+    {
+        t = *x;
+        *x = *y;
+        *y = t;
+    }
+}
+/*****************************************************************************/
+
+#endif /* OTHELLO_SYM_H_ */
@@ -0,0 +1,67 @@
+/*********************************************************************************************/
+//
+//  FILE        : packed_board.h
+//  DATE        : 2025/11/25 Tue.
+//  DESCRIPTION : 盤面の32ビットずつのビットボード表現
+//  CPU TYPE    : RX Family / ホストPC
+//
+//  Author T.Ijiro
+//
+//  棋譜の開始局面と中断局面(resume_flash.h)をデータフラッシュに残すときの盤面の形式.
+//  ビット y * 8 + x が brd[y][x] に対応し, red[0], green[0] が下位32ビット.
+//  othello_sym.h の board_to_bits もこれから64ビットのビットボードを作る.
+//  enum stone_color と MAT_WIDTH を使うので othello_ai.h からインクルードされる.
+/************************************************************************************************/
+#ifndef PACKED_BOARD_H_
+#define PACKED_BOARD_H_
+
+#include <stdint.h>
+
+/**************************************** 型定義 ********************************************/
+// 32ビットずつのビットボード. 構造体ごとデータフラッシュに残すときに使う.
+struct PackedBoard{
+    uint32_t red[2];   // 赤コマ (下位, 上位32ビット)
+    uint32_t green[2]; // 緑コマ
+};
+/****************************************************************************************/
+
+
+/************************************** 変換 ********************************************* */
+// 盤面を32ビットずつのビットボードにする. RXで64ビットの可変シフトを避ける.
+void pack_board(enum stone_color brd[][MAT_WIDTH], struct PackedBoard *pb)
+{
+    const enum stone_color *p = &brd[0][0];
+    int half, i;
+
+    for(half = 0; half < 2; half++)
+    {
+        pb->red[half]   = 0;
+        pb->green[half] = 0;
+
+        for(i = 0; i < 32; i++, p++)
+        {
+            pb->red[half]   |= (uint32_t)(*p == stone_red)   << i;
+            pb->green[half] |= (uint32_t)(*p == stone_green) << i;
+        }
+    }
+}
+
+// pack_board の逆. 盤面全体を書き換える.
+void unpack_board(const struct PackedBoard *pb, enum stone_color brd[][MAT_WIDTH])
+{
+    enum stone_color *p = &brd[0][0];
+    int half, i;
+
+    for(half = 0; half < 2; half++)
+    {
+        for(i = 0; i < 32; i++, p++)
+        {
+            if((pb->red[half] >> i) & 1)        *p = stone_red;
+            else if((pb->green[half] >> i) & 1) *p = stone_green;
+            else                                *p = stone_black;
+        }
+    }
+}
+/*****************************************************************************/
+
+#endif /* PACKED_BOARD_H_ */
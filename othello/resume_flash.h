@@ -0,0 +1,159 @@
+/*********************************************************************************************/
+//
+//  FILE        : resume_flash.h
+//  DATE        : 2025/11/25 Tue.
+//  DESCRIPTION : 中断局面のE2データフラッシュへの保存
+//  CPU TYPE    : RX Family / ホストPC
+//
+//  Author T.Ijiro
+//
+//  中断局面を RESUME_SLOT_SIZE バイトのスロットに通し番号つきで順に書き, 起動時に一番新しいものを探す.
+//  ・書くスロットがブロックの先頭ならそのブロックを先に消去する. 一番新しい局面は前のブロックに残る.
+//  ・magic 以外を書いてから magic を書くので, 途中で電源が切れたスロットは読まない.
+//  ・起動後は一番新しい局面の次のブロックの先頭から書く(書きかけのスロットに重ねて書かない).
+//  盤面などの中身を詰めるのと戻すのは othello.c (resume_save, resume_restore).
+//  ホストPCでの電源断の確認は host/check_resume.c を参照.
+/************************************************************************************************/
+#ifndef RESUME_FLASH_H_
+#define RESUME_FLASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "othello_ai.h" // 盤面の型と struct PackedBoard (packed_board.h)
+#include "data_flash.h"
+
+/************************************ マクロ *************************************************/
+#ifndef RESUME_DF_FIRST_BLOCK
+#define RESUME_DF_FIRST_BLOCK  48     // 先頭のブロック. 前のブロックは othello.c の棋譜が使う.
+#endif
+#define RESUME_DF_BLOCKS       (DF_BLOCKS - RESUME_DF_FIRST_BLOCK) // ブロック数
+#define RESUME_SLOT_SIZE       32     // 1局面のバイト数
+#define RESUME_SLOTS_PER_BLOCK (DF_BLOCK_SIZE / RESUME_SLOT_SIZE)
+#define RESUME_SLOTS           (RESUME_DF_BLOCKS * RESUME_SLOTS_PER_BLOCK)
+#define RESUME_MAGIC           0x5253 // 局面の先頭. 最後に書くので, これがあれば書き終わっている.
+#define RESUME_ACTIVE          0x01   // flags : 対局中 (0 = 終わった局面. 起動しても続けない)
+#define RESUME_BUZZER          0x02   // flags : game.is_buzzer_active
+#define RESUME_VS_AI           0x04   // flags : game.is_vs_AI
+#define RESUME_AI_TURN         0x08   // flags : game.is_AI_turn
+#define RESUME_SKIP            0x10   // flags : game.is_skip
+/********************************************************************************************/
+
+
+/**************************************** 型定義 ********************************************/
+// 中断局面. TURN_SWITCH で手番を替えた直後の状態で, 起動したら TURN_COUNT から続ける.
+struct ResumeSnapshot{
+    uint16_t           magic;    // RESUME_MAGIC
+    uint16_t           seq;      // 通し番号. 一番新しい局面を探す.
+    struct PackedBoard board;    // 盤面
+    unsigned char      color;    // 手番 (カーソルの色)
+    unsigned char      flags;    // RESUME_ACTIVE など
+    unsigned char      cursor;   // カーソルの位置. y * 8 + x.
+    unsigned char      reserved;
+    uint16_t           check;    // magic と check を除くバイトの和
+};
+
+// 1スロットに入らなければコンパイルエラーにする
+typedef char resume_slot_check[(sizeof(struct ResumeSnapshot) <= RESUME_SLOT_SIZE) ? 1 : -1];
+/****************************************************************************************/
+
+
+/*************************************** グローバル変数 ***************************************/
+static unsigned char         resume_ok;     // データフラッシュが使える
+static unsigned char         resume_active; // データフラッシュの一番新しい局面が対局中
+static uint16_t              resume_seq;    // 次に書く局面の通し番号
+static unsigned int          resume_next;   // 次に書くスロット
+static struct ResumeSnapshot resume_last;   // 一番新しい局面 (起動時に読んだもの)
+/*************************************************************************************************/
+
+
+/************************************************** 関数定義 **************************************************/
+// magic と check を除くバイトの和
+uint16_t resume_checksum(const struct ResumeSnapshot *snap)
+{
+    const unsigned char *p = (const unsigned char *)snap;
+    uint16_t sum = 0;
+    unsigned int i;
+
+    for(i = sizeof(snap->magic); i < offsetof(struct ResumeSnapshot, check); i++)
+    {
+        sum += p[i];
+    }
+
+    return sum;
+}
+
+// スロットの局面を読む. 書きかけや消去したままのスロットは読んだ値が不定なので magic と和で見分ける.
+// 戻り値 : 1 = 有効な局面, 0 = 無い
+int resume_read(unsigned int slot, struct ResumeSnapshot *snap)
+{
+    df_read(RESUME_DF_FIRST_BLOCK * DF_BLOCK_SIZE + slot * RESUME_SLOT_SIZE, snap, sizeof(*snap));
+
+    return (snap->magic == RESUME_MAGIC) && (snap->check == resume_checksum(snap));
+}
+
+// データフラッシュから一番新しい局面を探す. main で init_RX210 の後に呼ぶ.
+// 次はその次のブロックの先頭から書く(書きかけのスロットに重ねて書かないように).
+void resume_init(void)
+{
+    struct ResumeSnapshot snap;
+    unsigned int block, i, slot = 0;
+    int found = 0;
+
+    resume_ok = (df_init() == 0);
+    if(!resume_ok) return;
+
+    for(block = 0; block < RESUME_DF_BLOCKS; block++)
+    {
+        if(df_is_blank(RESUME_DF_FIRST_BLOCK + block)) continue;
+
+        for(i = 0; i < RESUME_SLOTS_PER_BLOCK; i++)
+        {
+            // 通し番号は16ビットで一周するので差で比べる
+            if(resume_read(block * RESUME_SLOTS_PER_BLOCK + i, &snap)
+               && (!found || ((int16_t)(snap.seq - resume_last.seq) > 0)))
+            {
+                resume_last = snap;
+                slot = block * RESUME_SLOTS_PER_BLOCK + i;
+                found = 1;
+            }
+        }
+    }
+
+    if(found)
+    {
+        resume_active = (resume_last.flags & RESUME_ACTIVE) != 0;
+        resume_seq    = resume_last.seq + 1;
+        resume_next   = ((slot / RESUME_SLOTS_PER_BLOCK + 1) % RESUME_DF_BLOCKS) * RESUME_SLOTS_PER_BLOCK;
+    }
+}
+
+// 局面を次のスロットに書く. ブロックの先頭なら先に消去する(一番新しい局面は前のブロックに残る).
+// 書き込みに数ms, 消去が入るとさらに数ms 待つ.
+void resume_write(struct ResumeSnapshot *snap)
+{
+    unsigned int offset = RESUME_DF_FIRST_BLOCK * DF_BLOCK_SIZE + resume_next * RESUME_SLOT_SIZE;
+
+    if(!resume_ok) return;
+
+    snap->magic    = RESUME_MAGIC;
+    snap->seq      = resume_seq;
+    snap->reserved = 0;
+    snap->check    = resume_checksum(snap);
+
+    if(resume_next % RESUME_SLOTS_PER_BLOCK == 0)
+    {
+        if(df_erase(RESUME_DF_FIRST_BLOCK + resume_next / RESUME_SLOTS_PER_BLOCK)) return;
+    }
+
+    resume_next = (resume_next + 1) % RESUME_SLOTS;
+    resume_seq++;
+
+    // magic 以外を書いてから magic を書く
+    if(df_write(offset + sizeof(snap->magic), (const unsigned char *)snap + sizeof(snap->magic), sizeof(*snap) - sizeof(snap->magic))) return;
+    if(df_write(offset, snap, sizeof(snap->magic))) return;
+
+    resume_active = (snap->flags & RESUME_ACTIVE) != 0;
+}
+/*************************************************************************************************/
+
+#endif /* RESUME_FLASH_H_ */
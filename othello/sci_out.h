@@ -0,0 +1,170 @@
+/*********************************************************************************************/
+//
+//  FILE        : sci_out.h
+//  DATE        : 2025/11/25 Tue.
+//  DESCRIPTION : SCI1 の調査用シリアル入出力 (57600bps, 8N1)
+//  CPU TYPE    : RX Family
+//
+//  Author T.Ijiro
+//
+//  TXD1 = P26, RXD1 = P30. USBシリアル変換などをつないで端末ソフトで見る.
+//  送信は送信バッファに積んで TXI1 の割込みで送るので, メインループはバッファが満杯のときだけ待つ.
+//  受信は割込みを使わず, sci_getc で IR(SCI1, RXI1) を見て1文字ずつ取り出す.
+//  TXI1 の割込み関数(Excep_SCI1_TXI1)から sci_txi を呼ぶこと.
+/************************************************************************************************/
+#ifndef SCI_OUT_H_
+#define SCI_OUT_H_
+
+#include "iodefine.h"
+#include "clock_config.h"
+
+/************************************ マクロ *************************************************/
+#define SCI_BAUD        57600UL    // ビットレート
+#define SCI_BRR         ((CLK_PCLKB_HZ + 8 * SCI_BAUD) / (16 * SCI_BAUD) - 1) // SEMR.ABCS = 1 (16分周)のときの BRR. PCLKB 25MHz で誤差 0.5%.
+#define SCI_PSEL        0x0A       // P26, P30 の端子機能選択 (TXD1, RXD1)
+#define SCI_TX_BUF_SIZE 256        // 送信バッファのバイト数(2のべき乗)
+/********************************************************************************************/
+
+
+/*************************************** グローバル変数 ***************************************/
+static volatile unsigned char sci_tx_buf[SCI_TX_BUF_SIZE]; // 送信バッファ
+static volatile unsigned int  sci_tx_wp;                   // 書き込み位置(メイン)
+static volatile unsigned int  sci_tx_rp;                   // 読み出し位置(割込み)
+static volatile unsigned char sci_tx_busy;                 // 送信中. 0 なら次の1文字は TDR に直接書く.
+/*************************************************************************************************/
+
+
+/************************************************** 関数定義 **************************************************/
+// SCI1 を調歩同期式 8N1 で初期化
+void init_SCI1(void)
+{
+    SYSTEM.PRCR.WORD = 0x0A502;
+    MSTP(SCI1) = 0;
+    SYSTEM.PRCR.WORD = 0x0A500;
+
+    SCI1.SCR.BYTE = 0x00;
+
+    // P26 = TXD1, P30 = RXD1
+    PORT2.PODR.BIT.B6 = 1;
+    PORT2.PDR.BIT.B6  = 1;
+    PORT3.PDR.BIT.B0  = 0;
+    MPC.PWPR.BIT.B0WI  = 0;
+    MPC.PWPR.BIT.PFSWE = 1;
+    MPC.P26PFS.BIT.PSEL = SCI_PSEL;
+    MPC.P30PFS.BIT.PSEL = SCI_PSEL;
+    MPC.PWPR.BIT.PFSWE = 0;
+    MPC.PWPR.BIT.B0WI  = 1;
+    PORT2.PMR.BIT.B6 = 1;
+    PORT3.PMR.BIT.B0 = 1;
+
+    SCI1.SMR.BYTE  = 0x00;       // 調歩同期, 8ビット, パリティなし, 1ストップ, PCLK
+    SCI1.SCMR.BYTE = 0xF2;       // シリアルコミュニケーションインタフェースモード, LSBファースト
+    SCI1.SEMR.BIT.ABCS = 1;      // 1ビットを8クロックで数える
+    SCI1.BRR = SCI_BRR;
+
+    sci_tx_wp   = 0;
+    sci_tx_rp   = 0;
+    sci_tx_busy = 0;
+
+    IR(SCI1, RXI1)  = 0;
+    IEN(SCI1, RXI1) = 0;         // 受信は IR を見るだけ
+    IPR(SCI1, TXI1) = 1;
+    IEN(SCI1, TXI1) = 1;
+
+    SCI1.SCR.BYTE = 0xB0;        // TIE, TE, RE
+}
+
+// TXI1 (TDR が空いた) から呼ぶ. 送信バッファの次の1文字を送る.
+void sci_txi(void)
+{
+    unsigned int rp = sci_tx_rp;
+
+    if(rp == sci_tx_wp)
+    {
+        sci_tx_busy = 0;
+        return;
+    }
+
+    SCI1.TDR = sci_tx_buf[rp & (SCI_TX_BUF_SIZE - 1)];
+    sci_tx_rp = rp + 1;
+}
+
+// 1文字送る. 送信バッファが満杯なら空くまで待つ.
+void sci_putc(char c)
+{
+    unsigned int wp = sci_tx_wp;
+
+    while(wp - sci_tx_rp >= SCI_TX_BUF_SIZE)
+        ;
+
+    // 送信中でなければ TDR に直接書く. 割込みと取り合わないように割込み禁止にする.
+    IEN(SCI1, TXI1) = 0;
+
+    if(!sci_tx_busy)
+    {
+        sci_tx_busy = 1;
+        SCI1.TDR = (unsigned char)c;
+    }
+    else
+    {
+        sci_tx_buf[wp & (SCI_TX_BUF_SIZE - 1)] = (unsigned char)c;
+        sci_tx_wp = wp + 1;
+    }
+
+    IEN(SCI1, TXI1) = 1;
+}
+
+// 文字列を送る
+void sci_puts(const char *str)
+{
+    while(*str)
+    {
+        sci_putc(*str++);
+    }
+}
+
+// 符号なし整数を10進数で送る. width 桁に満たないときは左を空白で埋める.
+void sci_put_ulong(unsigned long value, int width)
+{
+    char str[10];
+    int  i = 0;
+
+    do
+    {
+        str[i++] = (char)('0' + value % 10);
+        value /= 10;
+    }
+    while(value);
+
+    for(; width > i; width--)
+    {
+        sci_putc(' ');
+    }
+
+    while(i > 0)
+    {
+        sci_putc(str[--i]);
+    }
+}
+
+// 受信した1文字を取り出す. 戻り値 : 文字, -1 = 受信していない
+int sci_getc(void)
+{
+    // 受信エラーは捨てて受信を続ける
+    if(SCI1.SSR.BYTE & 0x38)
+    {
+        (void)SCI1.RDR;
+        SCI1.SSR.BYTE = 0xC0;
+        IR(SCI1, RXI1) = 0;
+        return -1;
+    }
+
+    if(!IR(SCI1, RXI1)) return -1;
+
+    IR(SCI1, RXI1) = 0;
+
+    return SCI1.RDR;
+}
+/*************************************************************************************************/
+
+#endif /* SCI_OUT_H_ */
@@ -0,0 +1,207 @@
+/*********************************************************************************************/
+//
+//  FILE        : timer_wheel.h
+//  DATE        : 2025/11/25 Tue.
+//  DESCRIPTION : 1つのハードウェアタイマで動くソフトウェアタイマ(階層タイマホイール)
+//  CPU TYPE    : RX Family
+//
+//  Author T.Ijiro
+//
+//  tw_tick を一定周期(othello.c では CMT0 の1ms)で呼ぶと, 満了したタイマのコールバックを呼ぶ.
+//  タイマは満了までの時間で3段のホイールのどれかに入れる.
+//    段0 : 1 tick   × 64 スロット (〜63 tick)
+//    段1 : 64 tick  × 64 スロット (〜4095 tick)
+//    段2 : 4096 tick × 64 スロット (〜262143 tick. それより先は段2の最後に入れて入れ直す)
+//  段0 が1周するたびに段1 の1スロットを, 段1 が1周するたびに段2 の1スロットを下の段に入れ直すので,
+//  1 tick の処理はタイマの数によらずほぼ一定.
+//
+//  ・コールバックは tw_tick を呼んだ割込みの中で動く. コールバックから tw_start, tw_stop を呼んでよい.
+//  ・コールバックが 0 のタイマは満了すると fired を立てるだけ. メインループの期限判定に使う.
+//  ・tw_start, tw_stop はメインからも呼べる. ホイールを書き換える間だけ割込みを禁止する.
+/************************************************************************************************/
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+#include <machine.h>
+
+/************************************ マクロ *************************************************/
+#define TW_SLOT_BITS 6                        // 1段のスロット数のビット数
+#define TW_SLOTS     (1 << TW_SLOT_BITS)      // 1段のスロット数
+#define TW_SLOT_MASK (TW_SLOTS - 1)
+#define TW_LEVELS    3                        // 段数
+#define TW_MAX_DELAY ((1UL << (TW_SLOT_BITS * TW_LEVELS)) - 1) // 1回で入れられる最長の時間[tick]
+/********************************************************************************************/
+
+
+/**************************************** 型定義 ********************************************/
+// ソフトウェアタイマ. 使う側が静的に確保する.
+struct SoftTimer{
+    struct SoftTimer  *next;         // 同じスロットの次のタイマ
+    struct SoftTimer **pprev;        // 前のタイマの next (先頭ならスロット)を指す. 0 = 止まっている.
+    unsigned long      expires;      // 満了時刻[tick]
+    unsigned long      period;       // 周期[tick]. 0 = 1回だけ.
+    void             (*callback)(void);
+    volatile unsigned char fired;    // 満了した (コールバックが 0 のとき)
+};
+/****************************************************************************************/
+
+
+/*************************************** グローバル変数 ***************************************/
+static struct SoftTimer       *tw_wheel[TW_LEVELS][TW_SLOTS]; // スロットごとのタイマのリスト
+static volatile unsigned long  tw_now;                        // 現在時刻[tick]
+/*************************************************************************************************/
+
+
+/************************************************** 関数定義 **************************************************/
+// 満了時刻に合ったスロットにタイマを入れる. 割込み禁止で呼ぶ.
+void tw_insert(struct SoftTimer *t)
+{
+    unsigned long delta = t->expires - tw_now;
+    struct SoftTimer **slot;
+    int level;
+
+    if(delta > TW_MAX_DELAY)
+    {
+        // 遠すぎるときは段2の一番先に入れ, そこまで来たら入れ直す
+        slot = &tw_wheel[TW_LEVELS - 1][((tw_now + TW_MAX_DELAY) >> (TW_SLOT_BITS * (TW_LEVELS - 1))) & TW_SLOT_MASK];
+    }
+    else
+    {
+        for(level = 0; level < TW_LEVELS - 1; level++)
+        {
+            if(delta < (1UL << (TW_SLOT_BITS * (level + 1)))) break;
+        }
+
+        slot = &tw_wheel[level][(t->expires >> (TW_SLOT_BITS * level)) & TW_SLOT_MASK];
+    }
+
+    t->next = *slot;
+    if(t->next) t->next->pprev = &t->next;
+    t->pprev = slot;
+    *slot = t;
+}
+
+// タイマをリストから外す. 割込み禁止で呼ぶ.
+void tw_unlink(struct SoftTimer *t)
+{
+    if(!t->pprev) return;
+
+    *t->pprev = t->next;
+    if(t->next) t->next->pprev = t->pprev;
+
+    t->next  = 0;
+    t->pprev = 0;
+}
+
+// タイマを delay tick 後に満了させる. period が 0 でなければ以後 period tick ごとに満了する.
+// 動いているタイマは止めてから入れ直す.
+void tw_start(struct SoftTimer *t, unsigned long delay, unsigned long period, void (*callback)(void))
+{
+    unsigned long psw = get_psw();
+
+    clrpsw_i();
+
+    tw_unlink(t);
+
+    t->expires  = tw_now + (delay ? delay : 1);
+    t->period   = period;
+    t->callback = callback;
+    t->fired    = 0;
+
+    tw_insert(t);
+
+    set_psw(psw);
+}
+
+// タイマを止める
+void tw_stop(struct SoftTimer *t)
+{
+    unsigned long psw = get_psw();
+
+    clrpsw_i();
+    tw_unlink(t);
+    set_psw(psw);
+}
+
+// タイマが動いているか
+int tw_is_active(const struct SoftTimer *t)
+{
+    return t->pprev != 0;
+}
+
+// コールバックが 0 のタイマが満了したか
+int tw_fired(const struct SoftTimer *t)
+{
+    return t->fired;
+}
+
+// 上の段のスロットを下の段に入れ直す
+void tw_cascade(int level, int idx)
+{
+    struct SoftTimer *list = tw_wheel[level][idx];
+    struct SoftTimer *t;
+
+    tw_wheel[level][idx] = 0;
+
+    while(list)
+    {
+        t = list;
+        list = t->next;
+        t->pprev = 0;
+        tw_insert(t);
+    }
+}
+
+// 時刻を1 tick 進め, 満了したタイマを処理する. 一定周期の割込みから呼ぶ.
+void tw_tick(void)
+{
+    struct SoftTimer *list, *t;
+    unsigned long now = tw_now + 1;
+    int idx = now & TW_SLOT_MASK;
+    int level;
+
+    tw_now = now;
+
+    // 段0 が1周したら, 1周した段の1つ上まで上の段から順に入れ直す
+    if(idx == 0)
+    {
+        for(level = 1; level < TW_LEVELS - 1; level++)
+        {
+            if((now >> (TW_SLOT_BITS * level)) & TW_SLOT_MASK) break;
+        }
+
+        for(; level >= 1; level--)
+        {
+            tw_cascade(level, (now >> (TW_SLOT_BITS * level)) & TW_SLOT_MASK);
+        }
+    }
+
+    // このスロットのリストを切り離してから処理する. コールバックがタイマを入れ直してもよい.
+    list = tw_wheel[0][idx];
+    tw_wheel[0][idx] = 0;
+    if(list) list->pprev = &list;
+
+    while(list)
+    {
+        t = list;
+        tw_unlink(t);
+
+        if(t->period)
+        {
+            t->expires += t->period;
+            tw_insert(t);
+        }
+
+        if(t->callback)
+        {
+            t->callback();
+        }
+        else
+        {
+            t->fired = 1;
+        }
+    }
+}
+/*************************************************************************************************/
+
+#endif /* TIMER_WHEEL_H_ */